@@ -1,352 +1,594 @@
+#include <algorithm>
 #include "binary_tree.h"
 
 BinaryTree::BinaryTree(float partition_width) :
 	partition_width_(partition_width),
-	root_(nullptr)
+	root_(null_index)
 {
-	float total_width = partition_width * 2.0f;
+	create_root();
+}
+
+void BinaryTree::add_body(Body* body)
+{
+	uint32_t ball = balls_.allocate();
+	balls_[ball].body = body;
+
+	body->proxy_ = ball;
+
+	add_ball(ball);
+}
+
+void BinaryTree::add_bodies(Body* const* bodies, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// expand the binary tree once for all the bodies
+	float min_x = bodies[0]->min_x();
+	float max_x = bodies[0]->max_x();
+	for (size_t i = 1; i < count; i++)
+	{
+		min_x = std::min(min_x, bodies[i]->min_x());
+		max_x = std::max(max_x, bodies[i]->max_x());
+	}
+
+	while (nodes_[root_].min_x > min_x)
+	{
+		expand_on_left();
+	}
+	while (nodes_[root_].max_x < max_x)
+	{
+		expand_on_right();
+	}
+
+	// the new balls are appended to the lists of the leaves, remember where
+	// the old balls end in each leaf of the range
+	uint32_t first_leaf = find_leaf(min_x);
+	std::vector<uint32_t> old_last_entries;
+
+	uint32_t leaf = first_leaf;
+	while (true)
+	{
+		old_last_entries.push_back(nodes_[leaf].last_entry);
+
+		uint32_t right_brother = nodes_[leaf].right_brother;
+		if (right_brother == null_index || max_x <= nodes_[right_brother].min_x)
+		{
+			break;
+		}
+
+		leaf = right_brother;
+	}
+
+	// sorted by their left side, the bodies find their left leaf walking the
+	// leaves from left to right instead of descending the tree
+	std::vector<Body*> sorted_bodies(bodies, bodies + count);
+	std::sort(sorted_bodies.begin(), sorted_bodies.end(),
+		[](Body* a, Body* b)
+	{
+		return a->min_x() < b->min_x();
+	});
+
+	leaf = first_leaf;
+	for each (auto body in sorted_bodies)
+	{
+		uint32_t ball = balls_.allocate();
+		balls_[ball].body = body;
+
+		body->proxy_ = ball;
+
+		while (nodes_[leaf].max_x < body->min_x() && nodes_[leaf].right_brother != null_index)
+		{
+			leaf = nodes_[leaf].right_brother;
+		}
+
+		balls_[ball].left_leaf = leaf;
+
+		uint32_t current_leaf = leaf;
+		while (true)
+		{
+			append_ball(ball, current_leaf);
+
+			uint32_t right_brother = nodes_[current_leaf].right_brother;
+			if (right_brother == null_index || body->max_x() <= nodes_[right_brother].min_x)
+			{
+				break;
+			}
+
+			current_leaf = right_brother;
+		}
+
+		balls_[ball].right_leaf = current_leaf;
+	}
+
+	// pair every new ball with the balls before it in the leaf. A static ball
+	// can only pair with a dynamic one, so it skips the other static balls.
+	std::vector<Body*> dynamic_bodies;
+
+	leaf = first_leaf;
+	for each (auto old_last_entry in old_last_entries)
+	{
+		const Node& node = nodes_[leaf];
+		uint32_t first_new_entry = old_last_entry == null_index ? node.first_entry : ball_entries_[old_last_entry].next;
+
+		dynamic_bodies.clear();
+		for (uint32_t entry = node.first_entry; entry != first_new_entry; entry = ball_entries_[entry].next)
+		{
+			Body* leaf_body = balls_[ball_entries_[entry].ball].body;
+			if (leaf_body->type_ == Body::Type::DYNAMIC)
+			{
+				dynamic_bodies.push_back(leaf_body);
+			}
+		}
+
+		for (uint32_t entry = first_new_entry; entry != null_index; entry = ball_entries_[entry].next)
+		{
+			Body* body = balls_[ball_entries_[entry].ball].body;
+
+			if (body->type_ == Body::Type::DYNAMIC)
+			{
+				for (uint32_t other_entry = node.first_entry; other_entry != entry; other_entry = ball_entries_[other_entry].next)
+				{
+					Body* leaf_body = balls_[ball_entries_[other_entry].ball].body;
+					if (can_pair(body, leaf_body))
+					{
+						pair_cache_.add(body, leaf_body);
+					}
+				}
+
+				dynamic_bodies.push_back(body);
+			}
+			else
+			{
+				for each (auto dynamic_body in dynamic_bodies)
+				{
+					if (can_pair(body, dynamic_body))
+					{
+						pair_cache_.add(body, dynamic_body);
+					}
+				}
+			}
+		}
+
+		leaf = node.right_brother;
+	}
+}
+
+void BinaryTree::remove_body(Body* body)
+{
+	uint32_t ball = static_cast<uint32_t>(body->proxy_);
+
+	remove_ball(ball);
+
+	balls_.release(ball);
+}
+
+void BinaryTree::update_body(Body* body)
+{
+	update(static_cast<uint32_t>(body->proxy_));
+}
+
+float BinaryTree::get_max_update_distance() const
+{
+	return partition_width_;
+}
+
+void BinaryTree::query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const
+{
+	if (max_x < nodes_[root_].min_x || min_x > nodes_[root_].max_x)
+	{
+		return;
+	}
+
+	// walk the leaves along the x range of the box
+	uint32_t first_leaf = find_leaf(min_x);
+	for (uint32_t leaf = first_leaf; leaf != null_index && nodes_[leaf].min_x <= max_x; leaf = nodes_[leaf].right_brother)
+	{
+		for (uint32_t entry = nodes_[leaf].first_entry; entry != null_index; entry = ball_entries_[entry].next)
+		{
+			const Ball& ball = balls_[ball_entries_[entry].ball];
+
+			// a ball spanning several leaves is reported by the first one
+			if (leaf != first_leaf && ball.left_leaf != leaf)
+			{
+				continue;
+			}
 
-	root_ = new Branch(nullptr, 0.0f, total_width);
+			if (overlaps(ball.body, min_x, min_y, max_x, max_y))
+			{
+				bodies.push_back(ball.body);
+			}
+		}
+	}
+}
 
-	Leaf* left_leaf = new Leaf(root_, 0.0f, partition_width);
-	Leaf* right_leaf = new Leaf(root_, partition_width, total_width);
+void BinaryTree::create_root()
+{
+	float total_width = partition_width_ * 2.0f;
 
-	left_leaf->left_brother = nullptr;
-	left_leaf->right_brother = right_leaf;
-	right_leaf->left_brother = left_leaf;
-	right_leaf->right_brother = nullptr;
+	root_ = create_node(null_index, 0.0f, total_width, false);
 
-	root_->left_child = left_leaf;
-	root_->right_child = right_leaf;
+	uint32_t left_leaf = create_node(root_, 0.0f, partition_width_, true);
+	uint32_t right_leaf = create_node(root_, partition_width_, total_width, true);
+
+	nodes_[left_leaf].right_brother = right_leaf;
+	nodes_[right_leaf].left_brother = left_leaf;
+
+	nodes_[root_].left_child = left_leaf;
+	nodes_[root_].right_child = right_leaf;
 }
 
-BinaryTree::~BinaryTree()
+uint32_t BinaryTree::create_node(uint32_t father, float min_x, float max_x, bool is_leaf)
 {
-	delete root_;
+	uint32_t index = nodes_.allocate();
+
+	Node& node = nodes_[index];
+	node.father = father;
+	node.min_x = min_x;
+	node.max_x = max_x;
+	node.is_leaf = is_leaf;
+	node.left_child = null_index;
+	node.right_child = null_index;
+	node.left_brother = null_index;
+	node.right_brother = null_index;
+	node.first_entry = null_index;
+	node.last_entry = null_index;
+
+	return index;
 }
 
-void BinaryTree::add_ball(Ball* ball)
+void BinaryTree::add_ball(uint32_t ball)
 {
+	Body* body = balls_[ball].body;
+
 	// expand the binary tree if necessary
-	while (root_->min_x > ball->body->min_x_)
+	while (nodes_[root_].min_x > body->min_x())
 	{
 		expand_on_left();
 	}
-	while (root_->max_x < ball->body->max_x_)
+	while (nodes_[root_].max_x < body->max_x())
 	{
 		expand_on_right();
 	}
 
 	// find the leaf which can contain the extreme left side of the body
-	ball->left_leaf = find_leaf(ball->body->min_x_);
+	balls_[ball].left_leaf = find_leaf(body->min_x());
 
-	Leaf* current_leaf = ball->left_leaf;
+	uint32_t current_leaf = balls_[ball].left_leaf;
 	do
 	{
-		for each (auto leaf_ball in current_leaf->balls)
-		{
-			leaf_ball->bodies.push_back(ball->body);
-			push_unique<Body>(leaf_ball->body, ball->bodies);
-		}
+		push_ball(ball, current_leaf);
 
-		current_leaf->balls.push_back(ball);
-
-		if (current_leaf->right_brother == nullptr)
+		if (nodes_[current_leaf].right_brother == null_index)
 		{
-			ball->right_leaf = current_leaf;
+			balls_[ball].right_leaf = current_leaf;
 			return;
 		}
 
-		current_leaf = current_leaf->right_brother;
+		current_leaf = nodes_[current_leaf].right_brother;
 
-	} while (ball->body->max_x_ > current_leaf->min_x);
+	} while (body->max_x() > nodes_[current_leaf].min_x);
 
-	ball->right_leaf = current_leaf->left_brother;
+	balls_[ball].right_leaf = nodes_[current_leaf].left_brother;
 }
 
-void BinaryTree::remove_ball(Ball* ball)
+void BinaryTree::remove_ball(uint32_t ball)
 {
-	Leaf* current_leaf = ball->left_leaf;
-	do
+	uint32_t current_leaf = balls_[ball].left_leaf;
+	uint32_t right_leaf = balls_[ball].right_leaf;
+	while (true)
 	{
-		pop<Ball>(ball, current_leaf->balls);
+		pop_ball(ball, current_leaf);
 
-		for each (auto leaf_ball in current_leaf->balls)
+		// the bodies of the other balls in the leaf are no longer paired
+		for (uint32_t entry = nodes_[current_leaf].first_entry; entry != null_index; entry = ball_entries_[entry].next)
 		{
-			pop<Body>(ball->body, leaf_ball->bodies);
-			pop<Body>(leaf_ball->body, ball->bodies);
+			pair_cache_.remove(balls_[ball].body, balls_[ball_entries_[entry].ball].body);
 		}
 
-		current_leaf = current_leaf->right_brother;
+		if (current_leaf == right_leaf)
+		{
+			break;
+		}
 
-	} while (current_leaf != nullptr
-		&& current_leaf->min_x < ball->body->max_x_);
+		current_leaf = nodes_[current_leaf].right_brother;
+	}
 
-	ball->bodies.clear();
-	ball->left_leaf = nullptr;
-	ball->right_leaf = nullptr;
+	balls_[ball].left_leaf = null_index;
+	balls_[ball].right_leaf = null_index;
 }
 
-void BinaryTree::update(Ball* ball)
+void BinaryTree::update(uint32_t ball)
 {
-	Body* body = ball->body;
-	if (body->min_x_ >= ball->left_leaf->min_x
-		&& body->min_x_ <= ball->left_leaf->max_x
-		&& body->max_x_ >= ball->right_leaf->min_x
-		&& body->max_x_ <= ball->right_leaf->max_x)
+	Body* body = balls_[ball].body;
+	if (body->min_x() >= nodes_[balls_[ball].left_leaf].min_x
+		&& body->min_x() <= nodes_[balls_[ball].left_leaf].max_x
+		&& body->max_x() >= nodes_[balls_[ball].right_leaf].min_x
+		&& body->max_x() <= nodes_[balls_[ball].right_leaf].max_x)
 	{
 		return;
 	}
 
+	// the sides of the body move one leaf at a time, a fast or swept body can
+	// cross several leaves in a step
+
 	// if body has moved to the left and its extreme left side has moved to the
 	// left of the current left leaf, make the left brother of the current left
 	// leaf the new left leaf
-	if (body->min_x_ < ball->left_leaf->min_x)
+	while (body->min_x() < nodes_[balls_[ball].left_leaf].min_x)
 	{
 		// if the old left leaf has no left brother, expand the tree on the left
-		if (ball->left_leaf->left_brother == nullptr)
+		if (nodes_[balls_[ball].left_leaf].left_brother == null_index)
 		{
 			expand_on_left();
 		}
 
-		ball->left_leaf = ball->left_leaf->left_brother;
+		balls_[ball].left_leaf = nodes_[balls_[ball].left_leaf].left_brother;
 
-		for each (auto leaf_ball in ball->left_leaf->balls)
-		{
-			push_unique<Body>(ball->body, leaf_ball->bodies);
-			push_unique<Body>(leaf_ball->body, ball->bodies);
-		}
-
-		ball->left_leaf->balls.push_back(ball);
+		push_ball(ball, balls_[ball].left_leaf);
 	}
 
 	// if the body extreme right side has moved to the left of the current right leaf,
 	// make the left brother of the current right leaf the new right leaf
-	if (body->max_x_ < ball->right_leaf->min_x)
+	while (body->max_x() < nodes_[balls_[ball].right_leaf].min_x)
 	{
-		pop<Ball>(ball, ball->right_leaf->balls);
+		uint32_t right_leaf = balls_[ball].right_leaf;
 
-		for each (auto leaf_ball in ball->right_leaf->balls)
+		pop_ball(ball, right_leaf);
+
+		for (uint32_t entry = nodes_[right_leaf].first_entry; entry != null_index; entry = ball_entries_[entry].next)
 		{
-			if (ball->right_leaf == leaf_ball->left_leaf)
+			const Ball& leaf_ball = balls_[ball_entries_[entry].ball];
+			if (right_leaf == leaf_ball.left_leaf)
 			{
-				pop<Body>(ball->body, leaf_ball->bodies);
-				pop<Body>(leaf_ball->body, ball->bodies);
+				pair_cache_.remove(body, leaf_ball.body);
 			}
 		}
 
-		ball->right_leaf = ball->right_leaf->left_brother;
+		balls_[ball].right_leaf = nodes_[right_leaf].left_brother;
 	}
 
 	// ...or body has moved to the right and...
-	if (body->max_x_ > ball->right_leaf->max_x)
+	while (body->max_x() > nodes_[balls_[ball].right_leaf].max_x)
 	{
 		// if the old right leaf has no right brother, expand the tree on the right
-		if (ball->right_leaf->right_brother == nullptr)
+		if (nodes_[balls_[ball].right_leaf].right_brother == null_index)
 		{
 			expand_on_right();
 		}
 
-		ball->right_leaf = ball->right_leaf->right_brother;
+		balls_[ball].right_leaf = nodes_[balls_[ball].right_leaf].right_brother;
+
+		push_ball(ball, balls_[ball].right_leaf);
+	}
+
+	// if the body extreme left side has moved to the right of the current left leaf,
+	// make the right brother of the current left leaf the new left leaf
+	while (body->min_x() > nodes_[balls_[ball].left_leaf].max_x)
+	{
+		uint32_t left_leaf = balls_[ball].left_leaf;
+
+		pop_ball(ball, left_leaf);
 
-		for each (auto leaf_ball in ball->right_leaf->balls)
+		for (uint32_t entry = nodes_[left_leaf].first_entry; entry != null_index; entry = ball_entries_[entry].next)
 		{
-			push_unique<Body>(ball->body, leaf_ball->bodies);
-			push_unique<Body>(leaf_ball->body, ball->bodies);
+			const Ball& leaf_ball = balls_[ball_entries_[entry].ball];
+			if (left_leaf == leaf_ball.right_leaf)
+			{
+				pair_cache_.remove(body, leaf_ball.body);
+			}
 		}
 
-		ball->right_leaf->balls.push_back(ball);
+		balls_[ball].left_leaf = nodes_[left_leaf].right_brother;
 	}
+}
 
-	// if the body extreme left side has moved to the right of the current left leaf,
-	// make the right brother of the current left leaf the new left leaf
-	if (body->min_x_ > ball->left_leaf->max_x)
+void BinaryTree::push_ball(uint32_t ball, uint32_t leaf)
+{
+	Body* body = balls_[ball].body;
+
+	// pair the body with the bodies of the balls already in the leaf
+	for (uint32_t entry = nodes_[leaf].first_entry; entry != null_index; entry = ball_entries_[entry].next)
+	{
+		Body* leaf_body = balls_[ball_entries_[entry].ball].body;
+		if (can_pair(body, leaf_body))
+		{
+			pair_cache_.add(body, leaf_body);
+		}
+	}
+
+	append_ball(ball, leaf);
+}
+
+void BinaryTree::append_ball(uint32_t ball, uint32_t leaf)
+{
+	uint32_t new_entry = ball_entries_.allocate();
+	ball_entries_[new_entry].ball = ball;
+	ball_entries_[new_entry].next = null_index;
+
+	Node& node = nodes_[leaf];
+	if (node.last_entry == null_index)
 	{
-		pop<Ball>(ball, ball->left_leaf->balls);
+		node.first_entry = new_entry;
+	}
+	else
+	{
+		ball_entries_[node.last_entry].next = new_entry;
+	}
+	node.last_entry = new_entry;
+}
+
+void BinaryTree::pop_ball(uint32_t ball, uint32_t leaf)
+{
+	Node& node = nodes_[leaf];
 
-		for each (auto leaf_ball in ball->left_leaf->balls)
+	uint32_t previous_entry = null_index;
+	for (uint32_t entry = node.first_entry; entry != null_index; entry = ball_entries_[entry].next)
+	{
+		if (ball_entries_[entry].ball == ball)
 		{
-			if (ball->left_leaf == leaf_ball->right_leaf)
+			uint32_t next_entry = ball_entries_[entry].next;
+
+			if (previous_entry == null_index)
+			{
+				node.first_entry = next_entry;
+			}
+			else
+			{
+				ball_entries_[previous_entry].next = next_entry;
+			}
+
+			if (node.last_entry == entry)
 			{
-				pop<Body>(ball->body, leaf_ball->bodies);
-				pop<Body>(leaf_ball->body, ball->bodies);
+				node.last_entry = previous_entry;
 			}
+
+			ball_entries_.release(entry);
+			return;
 		}
 
-		ball->left_leaf = ball->left_leaf->right_brother;
+		previous_entry = entry;
 	}
 }
 
-BinaryTree::Leaf* BinaryTree::find_leaf(float x)
+uint32_t BinaryTree::find_leaf(float x) const
 {
-	Branch* current_node = root_;
+	uint32_t current_node = root_;
 	do
 	{
-		float mean_x = (current_node->min_x + current_node->max_x) / 2.0f;
+		const Node& node = nodes_[current_node];
+
+		float mean_x = (node.min_x + node.max_x) / 2.0f;
 		if (mean_x < x)
 		{
-			current_node = static_cast<Branch*>(current_node->right_child);
+			current_node = node.right_child;
 		}
 		else
 		{
-			current_node = static_cast<Branch*>(current_node->left_child);
+			current_node = node.left_child;
 		}
 
-	} while (!current_node->is_leaf);
+	} while (!nodes_[current_node].is_leaf);
 
-	return reinterpret_cast<Leaf*>(current_node);
+	return current_node;
 }
 
 void BinaryTree::expand_on_right()
 {
-	Branch* old_root = root_;
+	uint32_t old_root = root_;
+
+	float min_x = nodes_[old_root].min_x;
+	float max_x = nodes_[old_root].min_x + (nodes_[old_root].max_x - nodes_[old_root].min_x) * 2.0f;
+	root_ = create_node(null_index, min_x, max_x, false);
 
-	float min_x = old_root->min_x;
-	float max_x = old_root->min_x + (old_root->max_x - old_root->min_x) * 2.0f;
-	root_ = new Branch(nullptr, min_x, max_x);
+	uint32_t right_child = create_node(root_, nodes_[old_root].max_x, max_x, false);
 
-	root_->left_child = old_root;
-	root_->left_child->father = root_;
-	root_->right_child = new Branch(old_root, old_root->max_x, root_->max_x);
+	nodes_[root_].left_child = old_root;
+	nodes_[root_].right_child = right_child;
+	nodes_[old_root].father = root_;
 
 	// find the first leaf on the right starting from the old root
-	Branch* current_node = old_root;
+	uint32_t current_node = old_root;
 	do
 	{
-		current_node = static_cast<Branch*>(current_node->right_child);
+		current_node = nodes_[current_node].right_child;
 
-	} while (!current_node->is_leaf);
+	} while (!nodes_[current_node].is_leaf);
 
-	grow_on_left(static_cast<Branch*>(root_->right_child), current_node);
+	grow_on_left(right_child, current_node);
 }
 
 void BinaryTree::expand_on_left()
 {
-	Branch* old_root = root_;
+	uint32_t old_root = root_;
 
-	float min_x = old_root->max_x + (old_root->min_x - old_root->max_x) * 2.0f;
-	float max_x = old_root->max_x;
-	root_ = new Branch(nullptr, min_x, max_x);
+	float min_x = nodes_[old_root].max_x + (nodes_[old_root].min_x - nodes_[old_root].max_x) * 2.0f;
+	float max_x = nodes_[old_root].max_x;
+	root_ = create_node(null_index, min_x, max_x, false);
 
-	root_->right_child = old_root;
-	root_->right_child->father = root_;
-	root_->left_child = new Branch(old_root, root_->min_x, old_root->min_x);
+	uint32_t left_child = create_node(root_, min_x, nodes_[old_root].min_x, false);
+
+	nodes_[root_].right_child = old_root;
+	nodes_[root_].left_child = left_child;
+	nodes_[old_root].father = root_;
 
 	// find the first leaf on the left starting from the old root
-	Branch* current_node = old_root;
+	uint32_t current_node = old_root;
 	do
 	{
-		current_node = static_cast<Branch*>(current_node->left_child);
+		current_node = nodes_[current_node].left_child;
 
-	} while (!current_node->is_leaf);
+	} while (!nodes_[current_node].is_leaf);
 
-	grow_on_right(static_cast<Branch*>(root_->left_child), current_node);
+	grow_on_right(left_child, current_node);
 }
 
-BinaryTree::Node* BinaryTree::grow_on_right(Branch* branch, Node* right_brother)
+uint32_t BinaryTree::grow_on_right(uint32_t branch, uint32_t right_brother)
 {
+	float min_x = nodes_[branch].min_x;
+	float max_x = nodes_[branch].max_x;
+	float mean_x = (min_x + max_x) / 2.0f;
+
 	// this is a branch with leaves
-	if (branch->max_x - branch->min_x == partition_width_ * 2.0f)
+	if (max_x - min_x == partition_width_ * 2.0f)
 	{
-		float mean_x = (branch->min_x + branch->max_x) / 2.0f;
-		Leaf* left_leaf = new Leaf(branch, branch->min_x, mean_x);
-
-		Leaf* right_leaf = new Leaf(branch, mean_x, branch->max_x);
+		uint32_t left_leaf = create_node(branch, min_x, mean_x, true);
+		uint32_t right_leaf = create_node(branch, mean_x, max_x, true);
 
-		right_leaf->right_brother = static_cast<Leaf*>(right_brother);
-		right_leaf->right_brother->left_brother = right_leaf;
-		right_leaf->left_brother = left_leaf;
-		left_leaf->right_brother = right_leaf;
-		left_leaf->left_brother = nullptr;
+		nodes_[right_leaf].right_brother = right_brother;
+		nodes_[right_brother].left_brother = right_leaf;
+		nodes_[right_leaf].left_brother = left_leaf;
+		nodes_[left_leaf].right_brother = right_leaf;
 
-		branch->left_child = left_leaf;
-		branch->right_child = right_leaf;
+		nodes_[branch].left_child = left_leaf;
+		nodes_[branch].right_child = right_leaf;
 
-		return branch->left_child;
+		return left_leaf;
 	}
 
-	float mean_x = (branch->min_x + branch->max_x) / 2.0f;
+	uint32_t right_child = create_node(branch, mean_x, max_x, false);
+	nodes_[branch].right_child = right_child;
+	uint32_t r_b = grow_on_right(right_child, right_brother);
 
-	branch->right_child = new Branch(branch, mean_x, branch->max_x);
-	Node* r_b = grow_on_right(static_cast<Branch*>(branch->right_child), right_brother);
-
-	branch->left_child = new Branch(branch, branch->min_x, mean_x);
-	r_b = grow_on_right(static_cast<Branch*>(branch->left_child), r_b);
+	uint32_t left_child = create_node(branch, min_x, mean_x, false);
+	nodes_[branch].left_child = left_child;
+	r_b = grow_on_right(left_child, r_b);
 
 	return r_b;
 }
 
-BinaryTree::Node* BinaryTree::grow_on_left(Branch* branch, Node* left_brother)
+uint32_t BinaryTree::grow_on_left(uint32_t branch, uint32_t left_brother)
 {
+	float min_x = nodes_[branch].min_x;
+	float max_x = nodes_[branch].max_x;
+	float mean_x = (min_x + max_x) / 2.0f;
+
 	// this is a branch with leaves
-	if (branch->max_x - branch->min_x == partition_width_ * 2.0f)
+	if (max_x - min_x == partition_width_ * 2.0f)
 	{
-		float mean_x = (branch->min_x + branch->max_x) / 2.0f;
-		Leaf* left_leaf = new Leaf(branch, branch->min_x, mean_x);
+		uint32_t left_leaf = create_node(branch, min_x, mean_x, true);
+		uint32_t right_leaf = create_node(branch, mean_x, max_x, true);
 
-		Leaf* right_leaf = new Leaf(branch, mean_x, branch->max_x);
+		nodes_[left_leaf].left_brother = left_brother;
+		nodes_[left_brother].right_brother = left_leaf;
+		nodes_[left_leaf].right_brother = right_leaf;
+		nodes_[right_leaf].left_brother = left_leaf;
 
-		left_leaf->left_brother = static_cast<Leaf*>(left_brother);
-		left_leaf->left_brother->right_brother = left_leaf;
-		left_leaf->right_brother = right_leaf;
-		right_leaf->left_brother = left_leaf;
-		right_leaf->right_brother = nullptr;
+		nodes_[branch].left_child = left_leaf;
+		nodes_[branch].right_child = right_leaf;
 
-		branch->left_child = left_leaf;
-		branch->right_child = right_leaf;
-
-		return branch->right_child;
+		return right_leaf;
 	}
 
-	float mean_x = (branch->min_x + branch->max_x) / 2.0f;
-
-	branch->left_child = new Branch(branch, branch->min_x, mean_x);
-	Node* l_b = grow_on_left(static_cast<Branch*>(branch->left_child), left_brother);
+	uint32_t left_child = create_node(branch, min_x, mean_x, false);
+	nodes_[branch].left_child = left_child;
+	uint32_t l_b = grow_on_left(left_child, left_brother);
 
-	branch->right_child = new Branch(branch, mean_x, branch->max_x);
-	l_b = grow_on_left(static_cast<Branch*>(branch->right_child), l_b);
+	uint32_t right_child = create_node(branch, mean_x, max_x, false);
+	nodes_[branch].right_child = right_child;
+	l_b = grow_on_left(right_child, l_b);
 
 	return l_b;
 }
-
-BinaryTree::Node::Node(Node* father, float min_x, float max_x, bool is_leaf) :
-	min_x(min_x),
-	max_x(max_x),
-	father(father),
-	is_leaf(is_leaf)
-{
-}
-
-BinaryTree::Branch::Branch(Node* father, float min_x, float max_x) :
-	Node(father, min_x, max_x, false),
-	left_child(nullptr),
-	right_child(nullptr)
-{
-}
-
-BinaryTree::Branch::~Branch()
-{
-	if (left_child != nullptr)
-	{
-		delete left_child;
-		left_child = nullptr;
-	}
-
-	if (right_child != nullptr)
-	{
-		delete right_child;
-		right_child = nullptr;
-	}
-}
-
-BinaryTree::Leaf::Leaf(Node* father, float min_x, float max_x) :
-	Node(father, min_x, max_x, true),
-	left_brother(nullptr),
-	right_brother(nullptr)
-{
-}
-
-BinaryTree::Ball::Ball(Body* body) :
-	body(body)
-{
-}
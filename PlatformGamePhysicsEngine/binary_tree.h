@@ -1,79 +1,91 @@
 #pragma once
 
 #include <vector>
-#include "body.h"
+#include "broadphase.h"
+#include "pool.h"
 #include "utility.h"
 
-class BinaryTree
+// nodes, balls and the lists of balls of the leaves live in pools owned by
+// the tree and refer to each other by index.
+class BinaryTree :public Broadphase
 {
 public:
-	struct Ball;
-
 	BinaryTree(float partition_width);
-	~BinaryTree();
 
-	void add_ball(Ball* ball);
-	static void remove_ball(Ball* ball);
-	void update(Ball* ball);
+	void add_body(Body* body) override;
+	// expands the tree once, fills the leaves from left to right and pairs the
+	// new balls leaf by leaf, static balls only with dynamic ones
+	void add_bodies(Body* const* bodies, size_t count) override;
+	void remove_body(Body* body) override;
+	void update_body(Body* body) override;
+	void query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const override;
+	// update walks the leaves one at a time, a body moved further than a leaf
+	// is cheaper to insert again
+	float get_max_update_distance() const override;
 
 private:
 	struct Node;
-	struct Branch;
-	struct Leaf;
+	struct Ball;
+	struct Ball_Entry;
 
 	const float partition_width_;
 
-	Branch* root_;
+	uint32_t root_;
+
+	Pool<Node> nodes_;
+	Pool<Ball> balls_;
+	Pool<Ball_Entry> ball_entries_;
+
+	void create_root();
+	uint32_t create_node(uint32_t father, float min_x, float max_x, bool is_leaf);
 
-	Leaf* find_leaf(float x);
+	void add_ball(uint32_t ball);
+	void remove_ball(uint32_t ball);
+	void update(uint32_t ball);
+
+	void push_ball(uint32_t ball, uint32_t leaf);
+	void append_ball(uint32_t ball, uint32_t leaf);
+	void pop_ball(uint32_t ball, uint32_t leaf);
+
+	uint32_t find_leaf(float x) const;
 	void expand_on_right();
 	void expand_on_left();
-	Node* grow_on_right(Branch* branch, Node* right_brother);
-	Node* grow_on_left(Branch* branch, Node* left_brother);
+	uint32_t grow_on_right(uint32_t branch, uint32_t right_brother);
+	uint32_t grow_on_left(uint32_t branch, uint32_t left_brother);
 };
 
 struct BinaryTree::Node
 {
-	Node* father;
+	uint32_t father;
 
 	float min_x;
 	float max_x;
 
 	bool is_leaf;
 
-	Node(Node* father, float min_x, float max_x, bool is_leaf);
-	virtual ~Node() {}
-};
-
-struct BinaryTree::Branch :public Node
-{
-	Node* left_child;
-	Node* right_child;
-
-	Branch(Node* father, float min_x, float max_x);
-	~Branch();
-};
-
-struct BinaryTree::Leaf :public Node
-{
-	Leaf* left_brother;
-	Leaf* right_brother;
+	// branch
+	uint32_t left_child;
+	uint32_t right_child;
 
-	std::vector<Ball*> balls;
+	// leaf
+	uint32_t left_brother;
+	uint32_t right_brother;
 
-	Leaf(Node* father, float min_x, float max_x);
+	uint32_t first_entry;
+	uint32_t last_entry;
 };
 
 struct BinaryTree::Ball
 {
-	friend class BinaryTree;
-
 	Body* body;
-	std::vector<Body*> bodies;
 
-	Ball(Body* body);
+	uint32_t left_leaf;
+	uint32_t right_leaf;
+};
 
-private:
-	Leaf* left_leaf;
-	Leaf* right_leaf;
+// element of the list of balls of a leaf
+struct BinaryTree::Ball_Entry
+{
+	uint32_t ball;
+	uint32_t next;
 };
@@ -5,11 +5,32 @@ Body::Body(Type type, const Vector2f& position, Shape* shape, std::function<void
 	collision_callback_(collision_callback),
 	entity_(entity),
 	shape_(shape),
+	category_(1),
+	mask_(0xFFFFFFFF),
+	mass_(1.0f),
+	inverse_mass_(1.0f),
 	position_(position),
+	previous_position_(position),
 	impulse_(0.0f, 0.0f),
 	velocity_(0.0f, 0.0f),
 	min_x_(position.x + shape->get_min_x()),
-	max_x_(position.x + shape->get_max_x())
+	max_x_(position.x + shape->get_max_x()),
+	min_y_(position.y + shape->get_min_y()),
+	max_y_(position.y + shape->get_max_y()),
+	arrays_(nullptr),
+	array_index_(0),
+	is_awake_(true),
+	sleep_time_(0.0f),
+	is_continuous_(false),
+	time_of_impact_(1.0f),
+	impact_normal_(0.0f, 0.0f),
+	impact_body_(nullptr),
+	substep_count_(1),
+	id_(0),
+	proxy_(0),
+	list_index_(0),
+	position_correction_(0.0f, 0.0f),
+	velocity_correction_(0.0f, 0.0f)
 {
 }
 
@@ -20,7 +41,87 @@ Body::~Body()
 
 void Body::apply_impulse(const Vector2f& impulse)
 {
-	impulse_ += impulse;
+	this->impulse() += impulse;
+
+	wake_up();
+}
+
+bool Body::is_continuous() const
+{
+	return is_continuous_;
+}
+
+void Body::set_continuous(bool is_continuous)
+{
+	is_continuous_ = is_continuous;
+}
+
+uint32_t Body::get_category() const
+{
+	return category_;
+}
+
+void Body::set_category(uint32_t category)
+{
+	category_ = category;
+}
+
+uint32_t Body::get_mask() const
+{
+	return mask_;
+}
+
+void Body::set_mask(uint32_t mask)
+{
+	mask_ = mask;
+}
+
+float Body::get_mass() const
+{
+	return mass_;
+}
+
+float Body::get_inverse_mass() const
+{
+	return inverse_mass_;
+}
+
+void Body::set_mass(float mass)
+{
+	if (mass <= 0.0f)
+	{
+		throw std::runtime_error("the mass is not positive!");
+	}
+
+	mass_ = mass;
+	inverse_mass_ = 1.0f / mass;
+}
+
+bool Body::is_awake() const
+{
+	return is_awake_;
+}
+
+void Body::wake_up()
+{
+	sleep_time_ = 0.0f;
+
+	if (is_awake_)
+	{
+		return;
+	}
+
+	is_awake_ = true;
+
+	if (arrays_ != nullptr)
+	{
+		arrays_->wake_up(this);
+	}
+}
+
+Body_Handle Body::get_handle() const
+{
+	return handle_;
 }
 
 Body::Type Body::get_type() const
@@ -30,7 +131,29 @@ Body::Type Body::get_type() const
 
 const Vector2f& Body::get_position() const
 {
-	return position_;
+	return position();
+}
+
+const Vector2f& Body::get_previous_position() const
+{
+	return previous_position();
+}
+
+Vector2f Body::get_interpolated_position(float alpha) const
+{
+	return previous_position() + (position() - previous_position()) * alpha;
+}
+
+const Vector2f& Body::get_velocity() const
+{
+	return velocity();
+}
+
+void Body::set_velocity(const Vector2f& velocity)
+{
+	this->velocity() = velocity;
+
+	wake_up();
 }
 
 const Shape* Body::get_shape() const
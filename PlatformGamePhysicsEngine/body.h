@@ -1,32 +1,91 @@
 #pragma once
 
+#include <cstdint>
 #include <functional>
+#include <vector>
 #include "vector_2.h"
 #include "box_shape.h"
 #include "circle_shape.h"
 #include "chain_shape.h"
 #include "capsule_shape.h"
+#include "body_arrays.h"
+
+// refers to a body of a physics engine by the index of its slot and the
+// generation of the slot. Once the body is removed the generation of the slot
+// changes, and the engine resolves the handle to nullptr.
+struct Body_Handle
+{
+	uint32_t index;
+	uint32_t generation;
+
+	// the null handle, no slot has generation 0
+	Body_Handle();
+
+	bool operator==(const Body_Handle& other) const;
+	bool operator!=(const Body_Handle& other) const;
+};
 
 class Body
 {
 	friend class Physics_Engine;
 	friend class BinaryTree;
+	friend class Body_Arrays;
+	friend class Sort_And_Sweep;
+	friend class Uniform_Grid;
+	friend class Broadphase;
+	friend class Pair_Cache;
+	friend class Static_Index;
 
 public:
 	struct Collision;
 	enum Type;
+	enum Contact_Phase;
 
 	float friction_;
 	float bouncing_;
-	Vector2f velocity_;
 
 	Body(Type type, const Vector2f& position, Shape* shape, std::function<void(Collision& collision)> collision_callback, void* entity);
 	~Body();
 
 	void apply_impulse(const Vector2f& impulse);
 
+	// a continuous body is swept from its previous position against static
+	// bodies, so it doesn't pass through thin ones when it moves fast
+	bool is_continuous() const;
+	void set_continuous(bool is_continuous);
+
+	// layers the body belongs to, one per bit. Queries with a layer mask only
+	// see the bodies sharing at least one layer with it.
+	uint32_t get_category() const;
+	void set_category(uint32_t category);
+	// layers the body collides with. Two bodies are paired only if each one
+	// has a layer in the mask of the other, so set category and mask before
+	// adding the body to the physics engine.
+	uint32_t get_mask() const;
+	void set_mask(uint32_t mask);
+
+	// mass is positive, the corrections of a collision between two dynamic
+	// bodies are split by inverse mass
+	float get_mass() const;
+	float get_inverse_mass() const;
+	void set_mass(float mass);
+
+	// a sleeping body is neither integrated nor tested for collisions until
+	// something wakes it up
+	bool is_awake() const;
+	void wake_up();
+
+	// null until the body is added to a physics engine
+	Body_Handle get_handle() const;
+
 	Type get_type() const;
 	const Vector2f& get_position() const;
+	// position before the last fixed step, see Physics_Engine::step
+	const Vector2f& get_previous_position() const;
+	// position between the previous and the current one, alpha in [0, 1]
+	Vector2f get_interpolated_position(float alpha) const;
+	const Vector2f& get_velocity() const;
+	void set_velocity(const Vector2f& velocity);
 	const Shape* get_shape() const;
 	Shape* get_shape();
 	void* get_entiry();
@@ -36,22 +95,86 @@ private:
 
 	Shape* shape_;
 
+	uint32_t category_;
+	uint32_t mask_;
+
+	float mass_;
+	float inverse_mass_;
+
 	Vector2f position_;
+	Vector2f previous_position_;
+	Vector2f velocity_;
 	Vector2f impulse_;
 
 	float min_x_;
 	float max_x_;
+	float min_y_;
+	float max_y_;
+
+	// when the body state is kept by body arrays, the fields above are
+	// stale and the accessors below read the arrays instead
+	Body_Arrays* arrays_;
+	size_t array_index_;
+
+	Vector2f& position();
+	const Vector2f& position() const;
+	Vector2f& previous_position();
+	const Vector2f& previous_position() const;
+	Vector2f& velocity();
+	const Vector2f& velocity() const;
+	Vector2f& impulse();
+	float& min_x();
+	float& max_x();
+	float& min_y();
+	float& max_y();
+
+	bool is_awake_;
+	// time spent at rest
+	float sleep_time_;
+
+	bool is_continuous_;
+	// first impact found by the sweep during a step, time is in [0, 1]
+	float time_of_impact_;
+	Vector2f impact_normal_;
+	Body* impact_body_;
+
+	// number of substeps the body is integrated in during a step
+	size_t substep_count_;
+
+	// unique id given by the physics engine
+	uint32_t id_;
+	Body_Handle handle_;
+
+	// index of the body inside the broadphase
+	size_t proxy_;
+	// index of the body in the dynamic or static bodies of the engine
+	size_t list_index_;
+	// keys of the contacts tracked by the engine for this body
+	std::vector<uint64_t> contact_keys_;
+
+	// corrections accumulated by the narrowphase during a step
+	Vector2f position_correction_;
+	Vector2f velocity_correction_;
 
 	std::function<void(Collision& collision)> collision_callback_;
 
 	void* entity_;
 };
 
+// the phase of a contact is PERSIST unless the physics engine tracks contacts
+enum Body::Contact_Phase
+{
+	BEGIN,
+	PERSIST,
+	END
+};
+
 struct Body::Collision
 {
 	Vector2f normal;
 	float distance;
 	Body* collider_body;
+	Contact_Phase phase;
 };
 
 enum Body::Type
@@ -59,4 +182,75 @@ enum Body::Type
 	DYNAMIC,
 	STATIC,
 	SENSOR
-};
\ No newline at end of file
+};
+
+inline Body_Handle::Body_Handle() :
+	index(0),
+	generation(0)
+{
+}
+
+inline bool Body_Handle::operator==(const Body_Handle& other) const
+{
+	return index == other.index && generation == other.generation;
+}
+
+inline bool Body_Handle::operator!=(const Body_Handle& other) const
+{
+	return !(*this == other);
+}
+
+inline Vector2f& Body::position()
+{
+	return arrays_ != nullptr ? arrays_->positions[array_index_] : position_;
+}
+
+inline const Vector2f& Body::position() const
+{
+	return arrays_ != nullptr ? arrays_->positions[array_index_] : position_;
+}
+
+inline Vector2f& Body::previous_position()
+{
+	return arrays_ != nullptr ? arrays_->previous_positions[array_index_] : previous_position_;
+}
+
+inline const Vector2f& Body::previous_position() const
+{
+	return arrays_ != nullptr ? arrays_->previous_positions[array_index_] : previous_position_;
+}
+
+inline Vector2f& Body::velocity()
+{
+	return arrays_ != nullptr ? arrays_->velocities[array_index_] : velocity_;
+}
+
+inline const Vector2f& Body::velocity() const
+{
+	return arrays_ != nullptr ? arrays_->velocities[array_index_] : velocity_;
+}
+
+inline Vector2f& Body::impulse()
+{
+	return arrays_ != nullptr ? arrays_->impulses[array_index_] : impulse_;
+}
+
+inline float& Body::min_x()
+{
+	return arrays_ != nullptr ? arrays_->min_x[array_index_] : min_x_;
+}
+
+inline float& Body::max_x()
+{
+	return arrays_ != nullptr ? arrays_->max_x[array_index_] : max_x_;
+}
+
+inline float& Body::min_y()
+{
+	return arrays_ != nullptr ? arrays_->min_y[array_index_] : min_y_;
+}
+
+inline float& Body::max_y()
+{
+	return arrays_ != nullptr ? arrays_->max_y[array_index_] : max_y_;
+}
\ No newline at end of file
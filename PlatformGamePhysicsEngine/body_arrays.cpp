@@ -0,0 +1,185 @@
+#include <algorithm>
+#include "body_arrays.h"
+#include "body.h"
+
+Body_Arrays::Body_Arrays() :
+	awake_count(0)
+{
+}
+
+void Body_Arrays::add(Body* body)
+{
+	size_t index = bodies.size();
+
+	bodies.push_back(body);
+	positions.push_back(body->position_);
+	previous_positions.push_back(body->previous_position_);
+	velocities.push_back(body->velocity_);
+	impulses.push_back(body->impulse_);
+	min_x.push_back(body->min_x_);
+	max_x.push_back(body->max_x_);
+	min_y.push_back(body->min_y_);
+	max_y.push_back(body->max_y_);
+	shape_min_x.push_back(body->shape_->get_min_x());
+	shape_max_x.push_back(body->shape_->get_max_x());
+	shapes.push_back(body->shape_);
+
+	body->arrays_ = this;
+	body->array_index_ = index;
+
+	// the body is added awake
+	swap(index, awake_count);
+	awake_count++;
+}
+
+void Body_Arrays::remove(Body* body)
+{
+	if (body->array_index_ < awake_count)
+	{
+		put_to_sleep(body);
+	}
+
+	size_t index = body->array_index_;
+	size_t last = bodies.size() - 1;
+
+	// copy the state back to the body, it may outlive the arrays
+	body->position_ = positions[index];
+	body->previous_position_ = previous_positions[index];
+	body->velocity_ = velocities[index];
+	body->impulse_ = impulses[index];
+	body->min_x_ = min_x[index];
+	body->max_x_ = max_x[index];
+	body->min_y_ = min_y[index];
+	body->max_y_ = max_y[index];
+
+	body->arrays_ = nullptr;
+
+	// move the last body in the freed slot
+	bodies[index] = bodies[last];
+	positions[index] = positions[last];
+	previous_positions[index] = previous_positions[last];
+	velocities[index] = velocities[last];
+	impulses[index] = impulses[last];
+	min_x[index] = min_x[last];
+	max_x[index] = max_x[last];
+	min_y[index] = min_y[last];
+	max_y[index] = max_y[last];
+	shape_min_x[index] = shape_min_x[last];
+	shape_max_x[index] = shape_max_x[last];
+	shapes[index] = shapes[last];
+
+	bodies[index]->array_index_ = index;
+
+	bodies.pop_back();
+	positions.pop_back();
+	previous_positions.pop_back();
+	velocities.pop_back();
+	impulses.pop_back();
+	min_x.pop_back();
+	max_x.pop_back();
+	min_y.pop_back();
+	max_y.pop_back();
+	shape_min_x.pop_back();
+	shape_max_x.pop_back();
+	shapes.pop_back();
+}
+
+void Body_Arrays::update_shape(Body* body)
+{
+	size_t index = body->array_index_;
+
+	shapes[index] = body->shape_;
+	shape_min_x[index] = body->shape_->get_min_x();
+	shape_max_x[index] = body->shape_->get_max_x();
+
+	min_x[index] = positions[index].x + shape_min_x[index];
+	max_x[index] = positions[index].x + shape_max_x[index];
+	min_y[index] = positions[index].y + body->shape_->get_min_y();
+	max_y[index] = positions[index].y + body->shape_->get_max_y();
+}
+
+void Body_Arrays::wake_up(Body* body)
+{
+	swap(body->array_index_, awake_count);
+	awake_count++;
+}
+
+void Body_Arrays::put_to_sleep(Body* body)
+{
+	awake_count--;
+	swap(body->array_index_, awake_count);
+}
+
+void Body_Arrays::swap(size_t index, size_t other_index)
+{
+	if (index == other_index)
+	{
+		return;
+	}
+
+	std::swap(bodies[index], bodies[other_index]);
+	std::swap(positions[index], positions[other_index]);
+	std::swap(previous_positions[index], previous_positions[other_index]);
+	std::swap(velocities[index], velocities[other_index]);
+	std::swap(impulses[index], impulses[other_index]);
+	std::swap(min_x[index], min_x[other_index]);
+	std::swap(max_x[index], max_x[other_index]);
+	std::swap(min_y[index], min_y[other_index]);
+	std::swap(max_y[index], max_y[other_index]);
+	std::swap(shape_min_x[index], shape_min_x[other_index]);
+	std::swap(shape_max_x[index], shape_max_x[other_index]);
+	std::swap(shapes[index], shapes[other_index]);
+
+	bodies[index]->array_index_ = index;
+	bodies[other_index]->array_index_ = other_index;
+}
+
+void Body_Arrays::integrate(const Vector2f& gravity, float delta_time)
+{
+	const size_t count = awake_count;
+
+	// raw pointers let the compiler vectorize the loops
+	Vector2f* position = positions.data();
+	Vector2f* velocity = velocities.data();
+	Vector2f* impulse = impulses.data();
+
+	const float gravity_x = gravity.x * delta_time;
+	const float gravity_y = gravity.y * delta_time;
+
+	// keep the positions before the step for interpolation
+	std::copy(positions.begin(), positions.begin() + count, previous_positions.begin());
+
+	for (size_t i = 0; i < count; i++)
+	{
+		// add gravity effect to impulse and update velocity
+		velocity[i].x += impulse[i].x + gravity_x;
+		velocity[i].y += impulse[i].y + gravity_y;
+
+		// update position
+		position[i].x += velocity[i].x * delta_time;
+		position[i].y += velocity[i].y * delta_time;
+
+		// clear impulse
+		impulse[i].x = 0.0f;
+		impulse[i].y = 0.0f;
+	}
+
+	// update min_x and max_x
+	float* body_min_x = min_x.data();
+	float* body_max_x = max_x.data();
+	const float* body_shape_min_x = shape_min_x.data();
+	const float* body_shape_max_x = shape_max_x.data();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		body_min_x[i] = position[i].x + body_shape_min_x[i];
+		body_max_x[i] = position[i].x + body_shape_max_x[i];
+	}
+
+	// update min_y and max_y
+	for (size_t i = 0; i < count; i++)
+	{
+		min_y[i] = position[i].y + shapes[i]->get_min_y();
+		max_y[i] = position[i].y + shapes[i]->get_max_y();
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include "vector_2.h"
+
+class Body;
+class Shape;
+
+// contiguous per-field storage of the state of dynamic bodies. A body added to
+// the arrays reads and writes its position, velocity, impulse and extents here.
+class Body_Arrays
+{
+public:
+	// awake bodies come first, only they are integrated
+	size_t awake_count;
+
+	std::vector<Body*> bodies;
+
+	std::vector<Vector2f> positions;
+	std::vector<Vector2f> previous_positions;
+	std::vector<Vector2f> velocities;
+	std::vector<Vector2f> impulses;
+
+	std::vector<float> min_x;
+	std::vector<float> max_x;
+	std::vector<float> min_y;
+	std::vector<float> max_y;
+
+	// the x extents of a shape never change, the y extents of a capsule do
+	std::vector<float> shape_min_x;
+	std::vector<float> shape_max_x;
+	std::vector<const Shape*> shapes;
+
+	Body_Arrays();
+
+	void add(Body* body);
+	void remove(Body* body);
+
+	// reads the extents of the shape of the body again
+	void update_shape(Body* body);
+
+	// move the body across the boundary between awake and sleeping bodies
+	void wake_up(Body* body);
+	void put_to_sleep(Body* body);
+
+	void integrate(const Vector2f& gravity, float delta_time);
+
+private:
+	void swap(size_t index, size_t other_index);
+};
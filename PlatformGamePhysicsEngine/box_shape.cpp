@@ -1,7 +1,7 @@
 #include "box_shape.h"
 
 Box_Shape::Box_Shape(float half_width, float half_height) :
-	Shape(Type::BOX, -half_width, half_width),
+	Shape(Type::BOX, -half_width, half_width, -half_height, half_height),
 	half_width_(half_width),
 	half_height_(half_height)
 {
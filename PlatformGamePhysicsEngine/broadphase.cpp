@@ -0,0 +1,33 @@
+#include <limits>
+#include "broadphase.h"
+
+void Broadphase::add_bodies(Body* const* bodies, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		add_body(bodies[i]);
+	}
+}
+
+float Broadphase::get_max_update_distance() const
+{
+	return std::numeric_limits<float>::infinity();
+}
+
+const Pair_Cache& Broadphase::get_pair_cache() const
+{
+	return pair_cache_;
+}
+
+bool Broadphase::can_pair(const Body* body_a, const Body* body_b)
+{
+	// at least one of the bodies must be dynamic, and the layers of each body
+	// must be in the mask of the other
+	return (body_a->type_ == Body::Type::DYNAMIC || body_b->type_ == Body::Type::DYNAMIC)
+		&& (body_a->category_ & body_b->mask_) != 0 && (body_b->category_ & body_a->mask_) != 0;
+}
+
+bool Broadphase::overlaps(Body* body, float min_x, float min_y, float max_x, float max_y)
+{
+	return body->min_x() <= max_x && body->max_x() >= min_x && body->min_y() <= max_y && body->max_y() >= min_y;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vector>
+#include "pair_cache.h"
+
+class Broadphase
+{
+public:
+	virtual ~Broadphase() {}
+
+	virtual void add_body(Body* body) = 0;
+	// adds many bodies at once, by default one by one
+	virtual void add_bodies(Body* const* bodies, size_t count);
+	virtual void remove_body(Body* body) = 0;
+
+	// called after the extents of a body have changed
+	virtual void update_body(Body* body) = 0;
+	// longest move along x that update_body handles cheaply, a body moved
+	// further is better removed and added again
+	virtual float get_max_update_distance() const;
+
+	// appends the bodies whose extents overlap the box, each of them once
+	virtual void query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const = 0;
+
+	// candidate pairs kept up to date by add_body, remove_body and update_body
+	const Pair_Cache& get_pair_cache() const;
+
+	// at least one dynamic body, and the filters of both bodies accept the other
+	static bool can_pair(const Body* body_a, const Body* body_b);
+
+protected:
+	Pair_Cache pair_cache_;
+
+	static bool overlaps(Body* body, float min_x, float min_y, float max_x, float max_y);
+};
@@ -1,7 +1,7 @@
 #include "capsule_shape.h"
 
 Capsule_Shape::Capsule_Shape(float radius, float distance) :
-	Shape(Shape::Type::CAPSULE, -radius, radius),
+	Shape(Shape::Type::CAPSULE, -radius, radius, -radius, distance + radius),
 	radius_(radius),
 	distance_(distance)
 {
@@ -19,6 +19,8 @@ void Capsule_Shape::set_distance(float distance)
 	}
 
 	distance_ = distance;
+
+	set_max_y(distance + radius_);
 }
 
 float Capsule_Shape::get_radius() const
@@ -1,7 +1,8 @@
+#include <algorithm>
 #include "chain_shape.h"
 
 Chain_Shape::Chain_Shape(const std::vector<Vector2f>& vertices) :
-	Shape(Shape::Type::CHAIN, vertices[0].x, vertices[vertices.size() - 1].x),
+	Shape(Shape::Type::CHAIN, vertices[0].x, vertices[vertices.size() - 1].x, compute_min_y(vertices), compute_max_y(vertices)),
 	vertices_(vertices)
 {
 	if (vertices[0].y != vertices[vertices.size() - 1].y)
@@ -16,9 +17,59 @@ Chain_Shape::Chain_Shape(const std::vector<Vector2f>& vertices) :
 			throw std::runtime_error("a vertex is on the left of its predecessor!");
 		}
 	}
+
+	for (size_t i = 0; i + 2 < vertices.size(); i += 2)
+	{
+		const Vector2f v0(vertices[i].x, vertices[0].y);
+		const Vector2f& v1 = vertices[i + 1];
+		const Vector2f& v2 = vertices[i + 2];
+
+		Segment segment;
+		segment.center = (v0 + v2) / 2.0f;
+		segment.half_width = v2.x - segment.center.x;
+		segment.half_height = v1.y - segment.center.y;
+		segments_.push_back(segment);
+	}
+}
+
+float Chain_Shape::compute_min_y(const std::vector<Vector2f>& vertices)
+{
+	float min_y = vertices[0].y;
+	for each (auto vertex in vertices)
+	{
+		min_y = std::min(min_y, vertex.y);
+	}
+
+	return min_y;
+}
+
+float Chain_Shape::compute_max_y(const std::vector<Vector2f>& vertices)
+{
+	float max_y = vertices[0].y;
+	for each (auto vertex in vertices)
+	{
+		max_y = std::max(max_y, vertex.y);
+	}
+
+	return max_y;
 }
 
 const std::vector<Vector2f>& Chain_Shape::get_vertices() const
 {
 	return vertices_;
 }
+
+const std::vector<Chain_Shape::Segment>& Chain_Shape::get_segments() const
+{
+	return segments_;
+}
+
+size_t Chain_Shape::find_first_segment(float x) const
+{
+	auto it = std::lower_bound(segments_.begin(), segments_.end(), x, [](const Segment& segment, float value)
+	{
+		return segment.center.x + segment.half_width < value;
+	});
+
+	return it - segments_.begin();
+}
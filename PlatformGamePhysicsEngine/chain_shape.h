@@ -9,10 +9,29 @@ class Chain_Shape :public Shape
 	friend class Physics_Engine;
 
 public:
+	// box under the top of a column of the chain, from the y of the first
+	// vertex up
+	struct Segment
+	{
+		Vector2f center;
+		float half_width;
+		float half_height;
+	};
+
 	Chain_Shape(const std::vector<Vector2f>& vertices);
 
 	const std::vector<Vector2f>& get_vertices() const;
+	const std::vector<Segment>& get_segments() const;
+
+	// index of the first segment whose right side is not on the left of x.
+	// Segments are sorted on x, so the following ones can be walked until
+	// their left side passes the right side of the body.
+	size_t find_first_segment(float x) const;
 
 private:
 	std::vector<Vector2f> vertices_;
+	std::vector<Segment> segments_;
+
+	static float compute_min_y(const std::vector<Vector2f>& vertices);
+	static float compute_max_y(const std::vector<Vector2f>& vertices);
 };
@@ -1,7 +1,7 @@
 #include "circle_shape.h"
 
 Circle_Shape::Circle_Shape(float radius) :
-	Shape(Shape::Type::CIRCLE, -radius, radius),
+	Shape(Shape::Type::CIRCLE, -radius, radius, -radius, radius),
 	radius_(radius)
 {
 	if (radius <= 0.0f)
@@ -13,7 +13,7 @@ enum Entity_Id
 	GOOMBA
 };
 
-std::vector<Body*> bodies_to_be_deleted;
+std::vector<Body_Handle> bodies_to_be_deleted;
 
 class Mario
 {
@@ -70,7 +70,18 @@ public:
 
 	void collision_callback(Body::Collision& collision)
 	{
+		if (collision.phase == Body::Contact_Phase::END)
+		{
+			return;
+		}
+
+		// the terrain is checked at every step, the rest only when touched
 		int entity_id = reinterpret_cast<int>(collision.collider_body->get_entiry());
+		if (entity_id != Entity_Id::TERRAIN && collision.phase != Body::Contact_Phase::BEGIN)
+		{
+			return;
+		}
+
 		switch (entity_id)
 		{
 		case Entity_Id::TERRAIN:
@@ -81,12 +92,12 @@ public:
 			break;
 		case Entity_Id::COIN:
 			std::cout << "mario: got coin!" << std::endl;
-			bodies_to_be_deleted.push_back(collision.collider_body);
+			bodies_to_be_deleted.push_back(collision.collider_body->get_handle());
 			break;
 		case Entity_Id::STAR:
 			std::cout << "mario: got mushroom!" << std::endl;
 			should_become_super_ = !is_super_;
-			bodies_to_be_deleted.push_back(collision.collider_body);
+			bodies_to_be_deleted.push_back(collision.collider_body->get_handle());
 			break;
 		case Entity_Id::GOOMBA:
 		{
@@ -98,7 +109,7 @@ public:
 				Vector2f impulse(collision.normal * 10.0f);
 				body_->apply_impulse(impulse);
 
-				bodies_to_be_deleted.push_back(collision.collider_body);
+				bodies_to_be_deleted.push_back(collision.collider_body->get_handle());
 			}
 			else if (is_super_)
 			{
@@ -120,16 +131,30 @@ public:
 class Goomba
 {
 public:
-	Body* body_;
+	// a handle, the body is destroyed when mario stomps the goomba
+	Body_Handle body_;
 	float velocity_x_ = -2.0f;
 
-	void update()
+	// false once the body of the goomba has been destroyed
+	bool update(const Physics_Engine& physics_engine)
 	{
-		body_->velocity_.x = velocity_x_;
+		Body* body = physics_engine.get_body(body_);
+		if (body == nullptr)
+		{
+			return false;
+		}
+
+		body->set_velocity(Vector2f(velocity_x_, body->get_velocity().y));
+		return true;
 	}
 
 	void collision_callback(Body::Collision& collision)
 	{
+		if (collision.phase == Body::Contact_Phase::END)
+		{
+			return;
+		}
+
 		int entity_id = reinterpret_cast<int>(collision.collider_body->get_entiry());
 		switch (entity_id)
 		{
@@ -142,7 +167,10 @@ public:
 			}
 			break;
 		case Entity_Id::GOOMBA:
-			std::cout << "goomba: colliding with goomba!" << std::endl;
+			if (collision.phase == Body::Contact_Phase::BEGIN)
+			{
+				std::cout << "goomba: colliding with goomba!" << std::endl;
+			}
 
 			if (collision.normal.x != 0.0f)
 			{
@@ -157,6 +185,7 @@ public:
 
 
 const float deltaTime = 1.0f / 144.0f;
+int last_time = 0;
 const std::vector<Vector2f> vertices = {
 	{0.0f, 0.0f},
 	{0.0f, 5.0f},
@@ -176,7 +205,7 @@ const std::vector<Vector2f> vertices = {
 Physics_Engine* physics_engine(nullptr);
 Mario* mario(nullptr);
 std::vector<Goomba*> goombas;
-std::vector<Body*> bodies;
+std::vector<Body_Handle> bodies;
 Vector2f camera_position(0.0f, 0.0f);
 
 
@@ -192,11 +221,7 @@ void release_data()
 		delete goombas[i];
 	}
 
-	for (size_t i = 0; i < bodies.size(); i++)
-	{
-		delete bodies[i];
-	}
-
+	// the physics engine deletes the bodies it has created
 	if (physics_engine != nullptr)
 	{
 		delete physics_engine;
@@ -211,7 +236,10 @@ void load_data()
 	try
 	{
 		Vector2f gravity(0.0f, -9.81f);
-		physics_engine = new Physics_Engine(gravity);
+		Physics_Engine::Settings settings;
+		settings.fixed_delta_time = deltaTime;
+		settings.track_contacts = true;
+		physics_engine = new Physics_Engine(gravity, settings);
 
 		Body::Type type;
 		Vector2f position;
@@ -223,11 +251,10 @@ void load_data()
 			type = Body::Type::STATIC;
 			position = Vector2f(0.0f, -4.0f);
 			shape = new Chain_Shape(vertices);
-			body = new Body(type, position, shape, nullptr, entity);
+			body = physics_engine->get_body(physics_engine->create_body(type, position, shape, nullptr, entity));
 			body->bouncing_ = 0.0f;
 			body->friction_ = 1.0f;
-			physics_engine->add_body(body);
-			bodies.push_back(body);
+			bodies.push_back(body->get_handle());
 			shape = nullptr;
 			body = nullptr;
 		}
@@ -241,11 +268,10 @@ void load_data()
 				type = Body::Type::SENSOR;
 				position = Vector2f(0.5f + i * 2.0f, 4.0f + j * 2.0f);
 				shape = new Circle_Shape(0.5f);
-				body = new Body(type, position, shape, nullptr, entity);
+				body = physics_engine->get_body(physics_engine->create_body(type, position, shape, nullptr, entity));
 				body->bouncing_ = 0.0f;
 				body->friction_ = 1.0f;
-				physics_engine->add_body(body);
-				bodies.push_back(body);
+				bodies.push_back(body->get_handle());
 				shape = nullptr;
 				body = nullptr;
 			}
@@ -259,7 +285,7 @@ void load_data()
 			type = Body::Type::DYNAMIC;
 			position = Vector2f(9.0f, 2.0f);
 			shape = new Circle_Shape(0.5f);
-			body = new Body(
+			body = physics_engine->get_body(physics_engine->create_body(
 				type,
 				position,
 				shape,
@@ -269,13 +295,12 @@ void load_data()
 					std::placeholders::_1
 				),
 				entity
-			);
+			));
 			body->bouncing_ = 0.0f;
 			body->friction_ = 0.0f;
 			body->apply_impulse(Vector2f(-2.0f, 0.0f));
-			physics_engine->add_body(body);
-			bodies.push_back(body);
-			goomba->body_ = body;
+			bodies.push_back(body->get_handle());
+			goomba->body_ = body->get_handle();
 			shape = nullptr;
 			body = nullptr;
 
@@ -285,7 +310,7 @@ void load_data()
 			type = Body::Type::DYNAMIC;
 			position = Vector2f(14.0f, 2.0f);
 			shape = new Circle_Shape(0.5f);
-			body = new Body(
+			body = physics_engine->get_body(physics_engine->create_body(
 				type,
 				position,
 				shape,
@@ -295,13 +320,12 @@ void load_data()
 					std::placeholders::_1
 				),
 				entity
-			);
+			));
 			body->bouncing_ = 0.0f;
 			body->friction_ = 0.0f;
 			body->apply_impulse(Vector2f(-2.0f, 0.0f));
-			physics_engine->add_body(body);
-			bodies.push_back(body);
-			goomba->body_ = body;
+			bodies.push_back(body->get_handle());
+			goomba->body_ = body->get_handle();
 			shape = nullptr;
 			body = nullptr;
 
@@ -311,7 +335,7 @@ void load_data()
 			type = Body::Type::DYNAMIC;
 			position = Vector2f(16.0f, 2.0f);
 			shape = new Circle_Shape(0.5f);
-			body = new Body(
+			body = physics_engine->get_body(physics_engine->create_body(
 				type,
 				position,
 				shape,
@@ -321,13 +345,12 @@ void load_data()
 					std::placeholders::_1
 				),
 				entity
-			);
+			));
 			body->bouncing_ = 0.0f;
 			body->friction_ = 0.0f;
 			body->apply_impulse(Vector2f(-2.0f, 0.0f));
-			physics_engine->add_body(body);
-			bodies.push_back(body);
-			goomba->body_ = body;
+			bodies.push_back(body->get_handle());
+			goomba->body_ = body->get_handle();
 			shape = nullptr;
 			body = nullptr;
 		}
@@ -338,7 +361,7 @@ void load_data()
 		type = Body::Type::DYNAMIC;
 		position = Vector2f(1.0f, 8.0f);
 		shape = new Capsule_Shape(0.5f, 0.0f);
-		body = new Body(
+		body = physics_engine->get_body(physics_engine->create_body(
 			type,
 			position,
 			shape,
@@ -348,11 +371,10 @@ void load_data()
 				std::placeholders::_1
 			),
 			entity
-		);
+		));
 		body->bouncing_ = 0.0f;
 		body->friction_ = 1.0f;
-		physics_engine->add_body(body);
-		bodies.push_back(body);
+		bodies.push_back(body->get_handle());
 		mario->body_ = body;
 		shape = nullptr;
 		body = nullptr;
@@ -362,23 +384,16 @@ void load_data()
 		type = Body::Type::DYNAMIC;
 		position = Vector2f(12.0f, 4.0f);
 		shape = new Circle_Shape(0.5f);
-		body = new Body(type, position, shape, nullptr, entity);
+		body = physics_engine->get_body(physics_engine->create_body(type, position, shape, nullptr, entity));
 		body->bouncing_ = 1.0f;
 		body->friction_ = 0.0f;
-		body->velocity_.x = 3.0f;
-		physics_engine->add_body(body);
-		bodies.push_back(body);
+		body->set_velocity(Vector2f(3.0f, 0.0f));
+		bodies.push_back(body->get_handle());
 		shape = nullptr;
 		body = nullptr;
 	}
 	catch (...)
 	{
-		if (body != nullptr)
-		{
-			delete body;
-			body = nullptr;
-		}
-
 		if (shape != nullptr)
 		{
 			delete shape;
@@ -391,28 +406,43 @@ void load_data()
 
 void idle()
 {
-	physics_engine->update(deltaTime);
+	int time = glutGet(GLUT_ELAPSED_TIME);
+	float elapsed_time = (time - last_time) / 1000.0f;
+	last_time = time;
 
-	for each (auto body in bodies_to_be_deleted)
+	// the game logic runs only on frames where the physics has stepped
+	if (physics_engine->step(elapsed_time) == 0)
 	{
-		physics_engine->remove_body(body);
+		glutPostRedisplay();
+		return;
+	}
 
-		for (auto it = bodies.begin(); it != bodies.end(); it++)
+	for each (auto handle in bodies_to_be_deleted)
+	{
+		// a body hit twice in a step is already gone the second time
+		if (!physics_engine->destroy_body(handle))
 		{
-			if ((*it) == body)
-			{
-				bodies.erase(it);
-				break;
-			}
+			continue;
 		}
+
+		bodies.erase(std::remove(bodies.begin(), bodies.end(), handle), bodies.end());
 	}
 	bodies_to_be_deleted.clear();
 
 	mario->update();
 
-	for each (auto goomba in goombas)
+	// goombas whose body has been destroyed are dropped
+	for (auto it = goombas.begin(); it != goombas.end();)
 	{
-		goomba->update();
+		if ((*it)->update(*physics_engine))
+		{
+			++it;
+		}
+		else
+		{
+			delete (*it);
+			it = goombas.erase(it);
+		}
 	}
 
 	camera_position.lerp(mario->body_->get_position(), 0.05f);
@@ -504,8 +534,14 @@ void display()
 	);
 
 	// draw bodies
-	for each (auto body in bodies)
+	for each (auto handle in bodies)
 	{
+		Body* body = physics_engine->get_body(handle);
+		if (body == nullptr)
+		{
+			continue;
+		}
+
 		Body::Type type = body->get_type();
 		if (type == Body::Type::DYNAMIC)
 		{
@@ -522,7 +558,7 @@ void display()
 
 		glPushMatrix();
 
-		const Vector2f& position = body->get_position();
+		Vector2f position = body->get_interpolated_position(physics_engine->get_alpha());
 		glTranslatef(position.x, position.y, 0.0f);
 
 		draw_shape(body->get_shape());
@@ -623,6 +659,7 @@ int main(int argc, char** argv)
 		glClearColor(0.25f, 0.25f, 0.25f, 0.0f);
 
 		load_data();
+		last_time = glutGet(GLUT_ELAPSED_TIME);
 
 #ifdef RUN_FULLSCREEN
 		glutFullScreen();
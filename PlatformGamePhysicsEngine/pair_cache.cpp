@@ -0,0 +1,66 @@
+#include "pair_cache.h"
+
+bool Pair_Cache::add(Body* body_a, Body* body_b)
+{
+	Pair pair = create_pair(body_a, body_b);
+
+	auto result = indices_.insert(std::make_pair(pair.key, pairs_.size()));
+	if (!result.second)
+	{
+		return false;
+	}
+
+	pairs_.push_back(pair);
+
+	return true;
+}
+
+bool Pair_Cache::remove(Body* body_a, Body* body_b)
+{
+	auto it = indices_.find(compute_key(body_a, body_b));
+	if (it == indices_.end())
+	{
+		return false;
+	}
+
+	size_t index = it->second;
+	indices_.erase(it);
+
+	// move the last pair in the freed slot
+	if (index != pairs_.size() - 1)
+	{
+		pairs_[index] = pairs_.back();
+		indices_[pairs_[index].key] = index;
+	}
+	pairs_.pop_back();
+
+	return true;
+}
+
+const std::vector<Pair_Cache::Pair>& Pair_Cache::get_pairs() const
+{
+	return pairs_;
+}
+
+Pair_Cache::Pair Pair_Cache::create_pair(Body* body_a, Body* body_b)
+{
+	if (body_a->id_ > body_b->id_)
+	{
+		std::swap(body_a, body_b);
+	}
+
+	Pair pair;
+	pair.body_a = body_a;
+	pair.body_b = body_b;
+	pair.key = compute_key(body_a, body_b);
+
+	return pair;
+}
+
+uint64_t Pair_Cache::compute_key(const Body* body_a, const Body* body_b)
+{
+	uint64_t id_a = body_a->id_;
+	uint64_t id_b = body_b->id_;
+
+	return id_a < id_b ? (id_a << 32) | id_b : (id_b << 32) | id_a;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+#include "body.h"
+
+// set of the overlapping pairs found by a broadphase. Pairs are keyed by the
+// ids of their bodies, so adding, removing and finding a pair is O(1).
+class Pair_Cache
+{
+public:
+	struct Pair;
+
+	// return false if the pair is already in the cache
+	bool add(Body* body_a, Body* body_b);
+	// return false if the pair is not in the cache
+	bool remove(Body* body_a, Body* body_b);
+
+	const std::vector<Pair>& get_pairs() const;
+
+	// the pair of the two bodies, ordered and keyed as in the cache
+	static Pair create_pair(Body* body_a, Body* body_b);
+	// the same key for both orders of the bodies
+	static uint64_t compute_key(const Body* body_a, const Body* body_b);
+
+private:
+	std::unordered_map<uint64_t, size_t> indices_;
+	std::vector<Pair> pairs_;
+};
+
+struct Pair_Cache::Pair
+{
+	// body_a has the smaller id
+	Body* body_a;
+	Body* body_b;
+	uint64_t key;
+};
@@ -1,166 +1,2077 @@
+#include <algorithm>
+#include <limits>
+#include <new>
 #include "physics_engine.h"
 
-Physics_Engine::Physics_Engine(const Vector2f& gravity) :
+// the batch kernels test 4 contacts at a time with SSE2 where available
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define PHYSICS_ENGINE_SSE2
+#include <emmintrin.h>
+#endif
+
+// the normal is undefined when the center of a body is on the other body, as
+// when two circles are on top of each other: push the dynamic body up then
+static Vector2f& normalize_normal(Vector2f& normal)
+{
+	if (normal.x == 0.0f && normal.y == 0.0f)
+	{
+		normal.y = 1.0f;
+		return normal;
+	}
+
+	return normal.normalize();
+}
+
+// time at which start + delta * time enters the box, if earlier than time.
+// Nothing is found if start is already inside.
+static bool intersect_segment_box(const Vector2f& start, const Vector2f& delta, const Vector2f& min, const Vector2f& max, float& time, Vector2f& normal)
+{
+	float enter_time = 0.0f;
+	float exit_time = time;
+	Vector2f enter_normal(0.0f, 0.0f);
+
+	for (size_t axis = 0; axis < 2; axis++)
+	{
+		float s = axis == 0 ? start.x : start.y;
+		float d = axis == 0 ? delta.x : delta.y;
+		float min_s = axis == 0 ? min.x : min.y;
+		float max_s = axis == 0 ? max.x : max.y;
+
+		if (d == 0.0f)
+		{
+			if (s < min_s || s > max_s)
+			{
+				return false;
+			}
+
+			continue;
+		}
+
+		// enter from the min side when moving forward
+		float t0 = (min_s - s) / d;
+		float t1 = (max_s - s) / d;
+		float side = -1.0f;
+		if (t0 > t1)
+		{
+			std::swap(t0, t1);
+			side = 1.0f;
+		}
+
+		if (t0 > enter_time)
+		{
+			enter_time = t0;
+			enter_normal = axis == 0 ? Vector2f(side, 0.0f) : Vector2f(0.0f, side);
+		}
+
+		exit_time = std::min(exit_time, t1);
+		if (enter_time > exit_time)
+		{
+			return false;
+		}
+	}
+
+	if (enter_normal.x == 0.0f && enter_normal.y == 0.0f)
+	{
+		return false;
+	}
+
+	time = enter_time;
+	normal = enter_normal;
+	return true;
+}
+
+// time at which start + delta * time enters the circle, if earlier than time.
+// Nothing is found if start is already inside.
+static bool intersect_segment_circle(const Vector2f& start, const Vector2f& delta, const Vector2f& center, float radius, float& time, Vector2f& normal)
+{
+	Vector2f m = start - center;
+
+	float c = m.dot(m) - radius * radius;
+	float b = m.dot(delta);
+	if (c <= 0.0f || b >= 0.0f)
+	{
+		return false;
+	}
+
+	float a = delta.dot(delta);
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+	{
+		return false;
+	}
+
+	float t = (-b - sqrtf(discriminant)) / a;
+	if (t >= time)
+	{
+		return false;
+	}
+
+	time = t;
+	normal = (m + delta * t) / radius;
+	return true;
+}
+
+Physics_Engine::Settings::Settings() :
+	use_body_arrays(false),
+	broadphase_type(Broadphase_Type::BINARY_TREE),
+	grid_cell_size(8.0f),
+	fixed_delta_time(1.0f / 60.0f),
+	max_step_count(5),
+	allow_sleeping(false),
+	sleep_velocity(0.05f),
+	time_to_sleep(0.5f),
+	worker_thread_count(0),
+	max_substep_count(1),
+	buffer_collision_events(false),
+	track_contacts(false),
+	report_persistent_contacts(true),
+	separate_static_bodies(false)
+{
+}
+
+Physics_Engine::Physics_Engine(const Vector2f& gravity, const Settings& settings) :
 	gravity_(gravity),
-	binary_tree_(20.0f)
+	settings_(settings),
+	accumulator_(0.0f),
+	broadphase_(nullptr),
+	thread_pool_(nullptr),
+	next_body_id_(0),
+	first_free_slot_(null_index),
+	reserved_slot_count_(0),
+	is_static_index_dirty_(false),
+	update_index_(0)
+{
+	if (settings.fixed_delta_time <= 0.0f)
+	{
+		throw std::runtime_error("the fixed delta time is not positive!");
+	}
+
+	if (settings.max_substep_count == 0)
+	{
+		throw std::runtime_error("the maximum substep count is zero!");
+	}
+
+	switch (settings.broadphase_type)
+	{
+	case Broadphase_Type::BINARY_TREE:
+		broadphase_ = new BinaryTree(20.0f);
+		break;
+	case Broadphase_Type::SORT_AND_SWEEP:
+		broadphase_ = new Sort_And_Sweep();
+		break;
+	case Broadphase_Type::UNIFORM_GRID:
+		broadphase_ = new Uniform_Grid(settings.grid_cell_size);
+		break;
+	default:
+		throw std::runtime_error("unknown broadphase type!");
+	}
+
+	for (size_t i = 0; i < Shape::Type::TYPE_COUNT; i++)
+	{
+		for (size_t j = 0; j < Shape::Type::TYPE_COUNT; j++)
+		{
+			collision_functions_[i][j] = nullptr;
+		}
+	}
+
+	for (size_t i = 0; i < function_count; i++)
+	{
+		batch_collision_functions_[i] = nullptr;
+		batch_ends_[i] = 0;
+	}
+
+	register_collision_function(Shape::Type::CIRCLE, Shape::Type::BOX, detect_and_solve_circle_box_collision);
+	register_collision_function(Shape::Type::CIRCLE, Shape::Type::CIRCLE, detect_and_solve_circle_circle_collision);
+	register_collision_function(Shape::Type::CIRCLE, Shape::Type::CHAIN, detect_and_solve_circle_chain_collision);
+	register_collision_function(Shape::Type::CAPSULE, Shape::Type::BOX, detect_and_solve_capsule_box_collision);
+	register_collision_function(Shape::Type::CAPSULE, Shape::Type::CIRCLE, detect_and_solve_capsule_circle_collision);
+	register_collision_function(Shape::Type::CAPSULE, Shape::Type::CHAIN, detect_and_solve_capsule_chain_collision);
+
+	batch_collision_functions_[Shape::Type::CIRCLE * Shape::Type::TYPE_COUNT + Shape::Type::BOX] = detect_and_solve_circle_box_collisions;
+	batch_collision_functions_[Shape::Type::CIRCLE * Shape::Type::TYPE_COUNT + Shape::Type::CIRCLE] = detect_and_solve_circle_circle_collisions;
+
+	if (settings.worker_thread_count > 0)
+	{
+		thread_pool_ = new Thread_Pool(settings.worker_thread_count);
+	}
+}
+
+Physics_Engine::~Physics_Engine()
+{
+	delete thread_pool_;
+	delete broadphase_;
+
+	// the shapes of the commands never applied
+	for each (auto command in commands_)
+	{
+		if (command.type == Command_Type::CREATE_BODY || command.type == Command_Type::SET_SHAPE)
+		{
+			delete command.shape;
+		}
+	}
+
+	for each (auto slot in body_slots_)
+	{
+		if (slot.body != nullptr && slot.is_owned)
+		{
+			slot.body->~Body();
+		}
+	}
+
+	for each (auto block in body_blocks_)
+	{
+		::operator delete(block);
+	}
+}
+
+void Physics_Engine::update(float delta_time)
+{
+	apply_commands();
+	update_static_index();
+
+	update_index_++;
+
+	if (settings_.use_body_arrays)
+	{
+		// update velocity, position and extents of dynamic bodies
+		body_arrays_.integrate(gravity_, delta_time);
+
+		// update broadphase
+		for (size_t i = 0; i < body_arrays_.awake_count; i++)
+		{
+			Body* body = body_arrays_.bodies[i];
+			if (body->is_continuous_)
+			{
+				begin_sweep(body);
+			}
+			else if (settings_.max_substep_count > 1)
+			{
+				begin_substeps(body, delta_time);
+			}
+
+			broadphase_->update_body(body);
+		}
+	}
+	else
+	{
+		// update velocity and position of dynamic bodies.
+		// update broadphase.
+		for each (auto body in dynamic_bodies_)
+		{
+			if (!body->is_awake_)
+			{
+				continue;
+			}
+
+			body->previous_position_ = body->position_;
+
+			// add gravity effect to impulse
+			body->impulse_ += gravity_ * delta_time;
+
+			// update velocity
+			body->velocity_ += body->impulse_;
+
+			// update position
+			body->position_ += body->velocity_ * delta_time;
+
+			// clear impulse
+			body->impulse_ = Vector2f(0.0f, 0.0f);
+
+			// update min_x, max_x, min_y and max_y
+			update_extents(body);
+
+			if (body->is_continuous_)
+			{
+				begin_sweep(body);
+			}
+			else if (settings_.max_substep_count > 1)
+			{
+				begin_substeps(body, delta_time);
+			}
+
+			// update broadphase
+			broadphase_->update_body(body);
+		}
+	}
+
+	if (settings_.separate_static_bodies)
+	{
+		find_static_pairs();
+	}
+
+	// move the fast bodies again in substeps
+	if (!substepped_bodies_.empty())
+	{
+		run_substeps(delta_time);
+	}
+
+	// move the continuous bodies back to their first impact
+	if (!continuous_bodies_.empty())
+	{
+		solve_impacts();
+	}
+
+	const auto& pairs = collect_pairs();
+
+	// find the contacts to test and group them by collision function, so that
+	// each batch runs a single kernel
+	group_contacts(pairs);
+
+	// the detection only reads the state of the bodies and every contact is
+	// written by a single test, so the batches can run on the workers
+	auto detect_collisions = [this](size_t begin, size_t end)
+	{
+		size_t batch_begin = 0;
+		for (size_t i = 0; i < function_count; i++)
+		{
+			size_t batch_end = batch_ends_[i];
+			size_t range_begin = std::max(begin, batch_begin);
+			size_t range_end = std::min(end, batch_end);
+			batch_begin = batch_end;
+
+			if (range_begin >= range_end)
+			{
+				continue;
+			}
+
+			if (batch_collision_functions_[i] != nullptr)
+			{
+				batch_collision_functions_[i](contacts_.data(), contact_order_.data() + range_begin, range_end - range_begin);
+				continue;
+			}
+
+			for (size_t j = range_begin; j < range_end; j++)
+			{
+				Contact& contact = contacts_[contact_order_[j]];
+				contact.has_collided = contact.collision_function(contact.dynamic_body, contact.other_body,
+					contact.position_correction, contact.velocity_correction, contact.collision);
+			}
+		}
+	};
+
+	if (thread_pool_ != nullptr)
+	{
+		thread_pool_->parallel_for(contact_order_.size(), 64, detect_collisions);
+	}
+	else
+	{
+		detect_collisions(0, contact_order_.size());
+	}
+
+	// accumulate corrections and run the callbacks on this thread, in pair order
+	for (size_t i = 0; i < contacts_.size(); i++)
+	{
+		apply_contact(contacts_[i]);
+	}
+
+	if (!sensor_contacts_.empty())
+	{
+		detect_sensor_overlaps();
+	}
+
+	if (settings_.allow_sleeping)
+	{
+		for each (auto pair in pairs)
+		{
+			find_bodies_to_wake_up(pair);
+		}
+	}
+
+	// solve collisions
+	for each (auto body in dynamic_bodies_)
+	{
+		if (!body->is_awake_)
+		{
+			continue;
+		}
+
+		body->position() += body->position_correction_;
+		body->velocity() += body->velocity_correction_;
+
+		body->position_correction_ = Vector2f(0.0f, 0.0f);
+		body->velocity_correction_ = Vector2f(0.0f, 0.0f);
+
+		if (settings_.allow_sleeping)
+		{
+			update_sleep(body, delta_time);
+		}
+	}
+
+	// bodies are woken up after the step so that all of them see the same state
+	for each (auto body in bodies_to_wake_up_)
+	{
+		body->wake_up();
+	}
+	bodies_to_wake_up_.clear();
+
+	if (settings_.track_contacts)
+	{
+		end_contacts();
+	}
+}
+
+size_t Physics_Engine::step(float elapsed_time)
+{
+	accumulator_ += elapsed_time;
+
+	size_t step_count = 0;
+	while (accumulator_ >= settings_.fixed_delta_time)
+	{
+		if (step_count == settings_.max_step_count)
+		{
+			// drop the time we can't catch up with
+			accumulator_ = 0.0f;
+			break;
+		}
+
+		update(settings_.fixed_delta_time);
+
+		accumulator_ -= settings_.fixed_delta_time;
+		step_count++;
+	}
+
+	return step_count;
+}
+
+bool Physics_Engine::raycast(const Vector2f& start, const Vector2f& end, Cast_Hit& hit)
+{
+	return cast(start, end, 0.0f, 0.0f, Cast_Mode::CLOSEST, hit, nullptr);
+}
+
+bool Physics_Engine::raycast_any(const Vector2f& start, const Vector2f& end, Cast_Hit& hit)
+{
+	return cast(start, end, 0.0f, 0.0f, Cast_Mode::ANY, hit, nullptr);
+}
+
+size_t Physics_Engine::raycast_all(const Vector2f& start, const Vector2f& end, std::vector<Cast_Hit>& hits)
+{
+	size_t hit_count = hits.size();
+
+	Cast_Hit hit;
+	cast(start, end, 0.0f, 0.0f, Cast_Mode::ALL, hit, &hits);
+
+	return hits.size() - hit_count;
+}
+
+bool Physics_Engine::shape_cast(const Shape* shape, const Vector2f& start, const Vector2f& end, Cast_Hit& hit)
+{
+	float radius;
+	float height;
+	if (!get_cast_size(shape, radius, height))
+	{
+		throw std::runtime_error("only circles and capsules can be cast!");
+	}
+
+	return cast(start, end, radius, height, Cast_Mode::CLOSEST, hit, nullptr);
+}
+
+bool Physics_Engine::shape_cast_any(const Shape* shape, const Vector2f& start, const Vector2f& end, Cast_Hit& hit)
+{
+	float radius;
+	float height;
+	if (!get_cast_size(shape, radius, height))
+	{
+		throw std::runtime_error("only circles and capsules can be cast!");
+	}
+
+	return cast(start, end, radius, height, Cast_Mode::ANY, hit, nullptr);
+}
+
+size_t Physics_Engine::shape_cast_all(const Shape* shape, const Vector2f& start, const Vector2f& end, std::vector<Cast_Hit>& hits)
+{
+	float radius;
+	float height;
+	if (!get_cast_size(shape, radius, height))
+	{
+		throw std::runtime_error("only circles and capsules can be cast!");
+	}
+
+	size_t hit_count = hits.size();
+
+	Cast_Hit hit;
+	cast(start, end, radius, height, Cast_Mode::ALL, hit, &hits);
+
+	return hits.size() - hit_count;
+}
+
+size_t Physics_Engine::raycast_batch(const Vector2f* origins, const Vector2f* directions, const float* lengths, size_t count, uint32_t layer_mask, Cast_Hit* hits)
+{
+	// most rays of AI and bullets are short, a group of rays overlapping each
+	// other along x costs a single broadphase query
+	const size_t max_group_size = 16;
+
+	update_static_index();
+
+	auto get_min_x = [=](uint32_t ray) { return std::min(origins[ray].x, origins[ray].x + directions[ray].x * lengths[ray]); };
+	auto get_max_x = [=](uint32_t ray) { return std::max(origins[ray].x, origins[ray].x + directions[ray].x * lengths[ray]); };
+
+	ray_order_.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		ray_order_[i] = static_cast<uint32_t>(i);
+	}
+
+	std::sort(ray_order_.begin(), ray_order_.end(),
+		[&](uint32_t a, uint32_t b) { return get_min_x(a) < get_min_x(b); });
+
+	ray_group_ends_.clear();
+	for (size_t i = 0; i < count;)
+	{
+		float group_max_x = get_max_x(ray_order_[i]);
+
+		size_t end = i + 1;
+		while (end < count && end - i < max_group_size && get_min_x(ray_order_[end]) <= group_max_x)
+		{
+			group_max_x = std::max(group_max_x, get_max_x(ray_order_[end]));
+			end++;
+		}
+
+		ray_group_ends_.push_back(end);
+		i = end;
+	}
+
+	auto cast_groups = [&](size_t begin, size_t end)
+	{
+		std::vector<Body*> bodies;
+
+		for (size_t group = begin; group < end; group++)
+		{
+			size_t first_ray = group > 0 ? ray_group_ends_[group - 1] : 0;
+			size_t last_ray = ray_group_ends_[group];
+
+			float min_x = std::numeric_limits<float>::max();
+			float min_y = std::numeric_limits<float>::max();
+			float max_x = -std::numeric_limits<float>::max();
+			float max_y = -std::numeric_limits<float>::max();
+			for (size_t i = first_ray; i < last_ray; i++)
+			{
+				uint32_t ray = ray_order_[i];
+				Vector2f ray_end = origins[ray] + directions[ray] * lengths[ray];
+
+				min_x = std::min(min_x, std::min(origins[ray].x, ray_end.x));
+				min_y = std::min(min_y, std::min(origins[ray].y, ray_end.y));
+				max_x = std::max(max_x, std::max(origins[ray].x, ray_end.x));
+				max_y = std::max(max_y, std::max(origins[ray].y, ray_end.y));
+			}
+
+			bodies.clear();
+			broadphase_->query(min_x, min_y, max_x, max_y, bodies);
+			static_index_.query(min_x, min_y, max_x, max_y, bodies);
+
+			bodies.erase(std::remove_if(bodies.begin(), bodies.end(),
+				[=](const Body* body) { return (body->category_ & layer_mask) == 0; }), bodies.end());
+
+			for (size_t i = first_ray; i < last_ray; i++)
+			{
+				uint32_t ray = ray_order_[i];
+				Vector2f start = origins[ray];
+				Vector2f delta_position = directions[ray] * lengths[ray];
+				Vector2f ray_end = start + delta_position;
+
+				float ray_min_x = std::min(start.x, ray_end.x);
+				float ray_min_y = std::min(start.y, ray_end.y);
+				float ray_max_x = std::max(start.x, ray_end.x);
+				float ray_max_y = std::max(start.y, ray_end.y);
+
+				Cast_Hit& hit = hits[ray];
+				hit.body = nullptr;
+				hit.fraction = 1.0f;
+
+				for each (auto body in bodies)
+				{
+					// the box of the group is much larger than the box of a ray
+					if (body->min_x() > ray_max_x || body->max_x() < ray_min_x || body->min_y() > ray_max_y || body->max_y() < ray_min_y)
+					{
+						continue;
+					}
+
+					float time = hit.fraction;
+					Vector2f normal;
+					if (cast_against(start, delta_position, 0.0f, 0.0f, body, time, normal))
+					{
+						hit.body = body;
+						hit.fraction = time;
+						hit.normal = normal;
+					}
+				}
+
+				hit.position = start + delta_position * hit.fraction;
+			}
+		}
+	};
+
+	if (thread_pool_ != nullptr)
+	{
+		thread_pool_->parallel_for(ray_group_ends_.size(), 4, cast_groups);
+	}
+	else
+	{
+		cast_groups(0, ray_group_ends_.size());
+	}
+
+	size_t hit_count = 0;
+	for (size_t i = 0; i < count; i++)
+	{
+		if (hits[i].body != nullptr)
+		{
+			hit_count++;
+		}
+	}
+
+	return hit_count;
+}
+
+void Physics_Engine::overlap_aabb(const Vector2f& min, const Vector2f& max, std::vector<Body*>& bodies)
+{
+	update_static_index();
+
+	broadphase_->query(min.x, min.y, max.x, max.y, bodies);
+	static_index_.query(min.x, min.y, max.x, max.y, bodies);
+}
+
+void Physics_Engine::register_collision_function(Shape::Type dynamic_shape_type, Shape::Type other_shape_type, Collision_Function collision_function)
+{
+	collision_functions_[dynamic_shape_type][other_shape_type] = collision_function;
+
+	// the batch kernels run the built-in functions only
+	batch_collision_functions_[dynamic_shape_type * Shape::Type::TYPE_COUNT + other_shape_type] = nullptr;
+}
+
+void Physics_Engine::group_contacts(const std::vector<Pair_Cache::Pair>& pairs)
+{
+	// find the contacts to test and count the contacts of each function
+	size_t batch_begins[function_count] = {};
+
+	contacts_.clear();
+	sensor_contacts_.clear();
+	for each (auto pair in pairs)
+	{
+		bool is_a_dynamic = pair.body_a->type_ == Body::Type::DYNAMIC;
+		bool is_b_dynamic = pair.body_b->type_ == Body::Type::DYNAMIC;
+
+		if (is_a_dynamic && is_b_dynamic)
+		{
+			// the pair is tested once, from the side that has a collision function
+			if (!pair.body_a->is_awake_ && !pair.body_b->is_awake_)
+			{
+				continue;
+			}
+
+			if (collision_functions_[pair.body_a->shape_->type_][pair.body_b->shape_->type_] != nullptr)
+			{
+				add_contact(pair.body_a, pair.body_b, batch_begins);
+			}
+			else
+			{
+				add_contact(pair.body_b, pair.body_a, batch_begins);
+			}
+		}
+		else if (is_a_dynamic && pair.body_a->is_awake_)
+		{
+			add_contact(pair.body_a, pair.body_b, batch_begins);
+		}
+		else if (is_b_dynamic && pair.body_b->is_awake_)
+		{
+			add_contact(pair.body_b, pair.body_a, batch_begins);
+		}
+	}
+
+	size_t begin = 0;
+	for (size_t i = 0; i < function_count; i++)
+	{
+		size_t batch_size = batch_begins[i];
+		batch_begins[i] = begin;
+		begin += batch_size;
+	}
+
+	contact_order_.resize(contacts_.size());
+	for (size_t i = 0; i < contacts_.size(); i++)
+	{
+		contact_order_[batch_begins[contacts_[i].function_index]++] = static_cast<uint32_t>(i);
+	}
+
+	// every batch begins has moved to the end of its batch
+	for (size_t i = 0; i < function_count; i++)
+	{
+		batch_ends_[i] = batch_begins[i];
+	}
+}
+
+void Physics_Engine::add_contact(Body* dynamic_body, Body* other_body, size_t* batch_sizes)
+{
+	Shape::Type dynamic_shape_type = dynamic_body->shape_->type_;
+	Shape::Type other_shape_type = other_body->shape_->type_;
+
+	Collision_Function collision_function = collision_functions_[dynamic_shape_type][other_shape_type];
+	if (collision_function == nullptr || !fast_detect_collision(dynamic_body, other_body))
+	{
+		return;
+	}
+
+	if (other_body->type_ == Body::Type::SENSOR)
+	{
+		sensor_contacts_.push_back(std::make_pair(dynamic_body, other_body));
+		return;
+	}
+
+	Contact contact;
+	contact.dynamic_body = dynamic_body;
+	contact.other_body = other_body;
+	contact.collision_function = collision_function;
+	contact.function_index = dynamic_shape_type * Shape::Type::TYPE_COUNT + other_shape_type;
+	contact.position_correction = Vector2f(0.0f, 0.0f);
+	contact.velocity_correction = Vector2f(0.0f, 0.0f);
+	contact.has_collided = false;
+	contacts_.push_back(contact);
+
+	batch_sizes[contact.function_index]++;
+}
+
+void Physics_Engine::apply_contact(const Contact& contact)
+{
+	if (!contact.has_collided)
+	{
+		return;
+	}
+
+	Body* dynamic_body = contact.dynamic_body;
+	Body* other_body = contact.other_body;
+
+	if (other_body->type_ != Body::Type::DYNAMIC)
+	{
+		dynamic_body->position_correction_ += contact.position_correction;
+		dynamic_body->velocity_correction_ += contact.velocity_correction;
+	}
+	else
+	{
+		// the corrections are computed as if the other body didn't move, split
+		// them by inverse mass. A sleeping body is not moved until it wakes up.
+		float inverse_mass = dynamic_body->is_awake_ ? dynamic_body->inverse_mass_ : 0.0f;
+		float other_inverse_mass = other_body->is_awake_ ? other_body->inverse_mass_ : 0.0f;
+		float total_inverse_mass = inverse_mass + other_inverse_mass;
+
+		float share = inverse_mass / total_inverse_mass;
+		float other_share = other_inverse_mass / total_inverse_mass;
+
+		dynamic_body->position_correction_ += contact.position_correction * share;
+		dynamic_body->velocity_correction_ += contact.velocity_correction * share;
+
+		other_body->position_correction_ -= contact.position_correction * other_share;
+		other_body->velocity_correction_ -= contact.velocity_correction * other_share;
+	}
+
+	report_collision(dynamic_body, contact.collision);
+}
+
+void Physics_Engine::detect_sensor_overlaps()
+{
+	for each (auto sensor_contact in sensor_contacts_)
+	{
+		Body* dynamic_body = sensor_contact.first;
+		Body* sensor_body = sensor_contact.second;
+
+		// the collision functions don't correct anything against a sensor
+		Vector2f position_correction(0.0f, 0.0f);
+		Vector2f velocity_correction(0.0f, 0.0f);
+		Body::Collision collision;
+
+		Collision_Function collision_function = collision_functions_[dynamic_body->shape_->type_][sensor_body->shape_->type_];
+		if (collision_function(dynamic_body, sensor_body, position_correction, velocity_correction, collision))
+		{
+			report_collision(dynamic_body, collision);
+		}
+	}
+}
+
+void Physics_Engine::report_collision(Body* body, const Body::Collision& collision)
+{
+	Body::Collision reported_collision = collision;
+	reported_collision.phase = Body::Contact_Phase::PERSIST;
+
+	if (settings_.track_contacts)
+	{
+		uint64_t key = Pair_Cache::compute_key(body, collision.collider_body);
+		auto result = tracked_contacts_.insert(std::make_pair(key, Tracked_Contact()));
+		Tracked_Contact& contact = result.first->second;
+
+		// a pair is reported once per step, the substeps may find it first
+		bool is_reported = !result.second && contact.update_index == update_index_;
+
+		if (result.second)
+		{
+			reported_collision.phase = Body::Contact_Phase::BEGIN;
+
+			contact.pair_bodies[0] = body;
+			contact.pair_bodies[1] = collision.collider_body;
+			link_contact(key, contact);
+		}
+
+		contact.body = body;
+		contact.collision = reported_collision;
+		contact.update_index = update_index_;
+
+		if (is_reported || (reported_collision.phase == Body::Contact_Phase::PERSIST && !settings_.report_persistent_contacts))
+		{
+			return;
+		}
+	}
+
+	dispatch_collision(body, reported_collision);
+}
+
+void Physics_Engine::dispatch_collision(Body* body, const Body::Collision& collision, const Body* skipped_body)
+{
+	Body* other_body = collision.collider_body;
+
+	if (settings_.buffer_collision_events)
+	{
+		Collision_Event event;
+		event.body = body->handle_;
+		event.other_body = other_body->handle_;
+		event.normal = collision.normal;
+		event.distance = collision.distance;
+		event.phase = collision.phase;
+		collision_events_.push_back(event);
+		return;
+	}
+
+	if (body != skipped_body && body->collision_callback_ != nullptr)
+	{
+		Body::Collision body_collision = collision;
+		body->collision_callback_(body_collision);
+	}
+
+	if (other_body != skipped_body && other_body->type_ == Body::Type::DYNAMIC && other_body->collision_callback_ != nullptr)
+	{
+		Body::Collision other_collision;
+		other_collision.collider_body = body;
+		other_collision.distance = collision.distance;
+		other_collision.normal = collision.normal * -1.0f;
+		other_collision.phase = collision.phase;
+		other_body->collision_callback_(other_collision);
+	}
+}
+
+void Physics_Engine::end_contacts()
+{
+	for (auto it = tracked_contacts_.begin(); it != tracked_contacts_.end();)
+	{
+		Tracked_Contact& contact = it->second;
+		if (contact.update_index == update_index_)
+		{
+			++it;
+			continue;
+		}
+
+		// sleeping bodies are not tested, but they still touch
+		Body* other_body = contact.collision.collider_body;
+		bool is_body_moving = contact.body->type_ == Body::Type::DYNAMIC && contact.body->is_awake_;
+		bool is_other_body_moving = other_body->type_ == Body::Type::DYNAMIC && other_body->is_awake_;
+		if (!is_body_moving && !is_other_body_moving)
+		{
+			contact.update_index = update_index_;
+			++it;
+			continue;
+		}
+
+		ended_contacts_.push_back(contact);
+		ended_contacts_.back().collision.phase = Body::Contact_Phase::END;
+
+		unlink_contact(contact);
+		it = tracked_contacts_.erase(it);
+	}
+
+	// a callback may remove bodies and change the set
+	for each (auto contact in ended_contacts_)
+	{
+		dispatch_collision(contact.body, contact.collision);
+	}
+	ended_contacts_.clear();
+}
+
+void Physics_Engine::forget_contacts(Body* body)
+{
+	// only the contacts of the body, not every tracked contact
+	while (!body->contact_keys_.empty())
+	{
+		auto it = tracked_contacts_.find(body->contact_keys_.back());
+		Tracked_Contact& contact = it->second;
+
+		ended_contacts_.push_back(contact);
+		ended_contacts_.back().collision.phase = Body::Contact_Phase::END;
+
+		unlink_contact(contact);
+		tracked_contacts_.erase(it);
+	}
+
+	// the other body of each pair sees the contact end, the removed body is
+	// still valid as collider but its own callback is not run
+	for each (auto contact in ended_contacts_)
+	{
+		dispatch_collision(contact.body, contact.collision, body);
+	}
+	ended_contacts_.clear();
+}
+
+void Physics_Engine::link_contact(uint64_t key, Tracked_Contact& contact)
+{
+	for (size_t i = 0; i < 2; i++)
+	{
+		Body* body = contact.pair_bodies[i];
+
+		contact.key_indices[i] = body->contact_keys_.size();
+		body->contact_keys_.push_back(key);
+	}
+}
+
+void Physics_Engine::unlink_contact(const Tracked_Contact& contact)
+{
+	for (size_t i = 0; i < 2; i++)
+	{
+		Body* body = contact.pair_bodies[i];
+		size_t index = contact.key_indices[i];
+
+		// the last key of the body takes the place of the removed one
+		uint64_t moved_key = body->contact_keys_.back();
+		body->contact_keys_[index] = moved_key;
+		body->contact_keys_.pop_back();
+
+		if (index == body->contact_keys_.size())
+		{
+			continue;
+		}
+
+		Tracked_Contact& moved_contact = tracked_contacts_.find(moved_key)->second;
+		size_t side = moved_contact.pair_bodies[0] == body ? 0 : 1;
+		moved_contact.key_indices[side] = index;
+	}
+}
+
+const std::vector<Physics_Engine::Collision_Event>& Physics_Engine::get_collision_events() const
+{
+	return collision_events_;
+}
+
+void Physics_Engine::clear_collision_events()
+{
+	collision_events_.clear();
+}
+
+void Physics_Engine::find_bodies_to_wake_up(const Pair_Cache::Pair& pair)
+{
+	bool is_a_awake = pair.body_a->type_ == Body::Type::DYNAMIC && pair.body_a->is_awake_;
+	bool is_b_awake = pair.body_b->type_ == Body::Type::DYNAMIC && pair.body_b->is_awake_;
+
+	// a moving body wakes up the sleeping bodies it touches
+	if (is_a_awake && pair.body_a->sleep_time_ == 0.0f && !is_b_awake && pair.body_b->type_ == Body::Type::DYNAMIC
+		&& fast_detect_collision(pair.body_a, pair.body_b))
+	{
+		bodies_to_wake_up_.push_back(pair.body_b);
+	}
+	else if (is_b_awake && pair.body_b->sleep_time_ == 0.0f && !is_a_awake && pair.body_a->type_ == Body::Type::DYNAMIC
+		&& fast_detect_collision(pair.body_b, pair.body_a))
+	{
+		bodies_to_wake_up_.push_back(pair.body_a);
+	}
+}
+
+void Physics_Engine::begin_substeps(Body* body, float delta_time)
+{
+	float half_size = get_substep_size(body->shape_);
+
+	// most bodies are slow, avoid the square root for them
+	float distance_squared = body->velocity().dot(body->velocity()) * delta_time * delta_time;
+	if (distance_squared <= half_size * half_size)
+	{
+		return;
+	}
+
+	float substep_count = ceilf(sqrtf(distance_squared) / half_size);
+	body->substep_count_ = std::min(static_cast<size_t>(substep_count), settings_.max_substep_count);
+
+	substepped_bodies_.push_back(body);
+	expand_to_sweep(body);
+}
+
+void Physics_Engine::run_substeps(float delta_time)
+{
+	for each (auto pair in collect_pairs())
+	{
+		if (pair.body_a->substep_count_ > 1 && pair.body_b->type_ == Body::Type::STATIC)
+		{
+			substep_contacts_.push_back(std::make_pair(pair.body_a, pair.body_b));
+		}
+		else if (pair.body_b->substep_count_ > 1 && pair.body_a->type_ == Body::Type::STATIC)
+		{
+			substep_contacts_.push_back(std::make_pair(pair.body_b, pair.body_a));
+		}
+	}
+
+	// group the contacts of each body, in the same order on every run
+	std::stable_sort(substep_contacts_.begin(), substep_contacts_.end(),
+		[](const std::pair<Body*, Body*>& a, const std::pair<Body*, Body*>& b) { return a.first->id_ < b.first->id_; });
+
+	std::sort(substepped_bodies_.begin(), substepped_bodies_.end(),
+		[](const Body* a, const Body* b) { return a->id_ < b->id_; });
+
+	size_t first_contact = 0;
+	for each (auto body in substepped_bodies_)
+	{
+		size_t last_contact = first_contact;
+		while (last_contact < substep_contacts_.size() && substep_contacts_[last_contact].first == body)
+		{
+			last_contact++;
+		}
+
+		// restart from the position before the step. The last substep ends
+		// where the regular narrowphase takes over.
+		Vector2f delta_position = get_substep_move(body, delta_time);
+		body->position() = body->previous_position();
+
+		for (size_t i = 1; i < body->substep_count_; i++)
+		{
+			body->position() += delta_position;
+
+			update_extents(body);
+
+			bool has_collided = false;
+			for (size_t j = first_contact; j < last_contact; j++)
+			{
+				Body* other_body = substep_contacts_[j].second;
+
+				Collision_Function collision_function = collision_functions_[body->shape_->type_][other_body->shape_->type_];
+				if (collision_function == nullptr || !fast_detect_collision(body, other_body))
+				{
+					continue;
+				}
+
+				Body::Collision collision;
+				if (collision_function(body, other_body, body->position_correction_, body->velocity_correction_, collision))
+				{
+					has_collided = true;
+
+					report_collision(body, collision);
+				}
+			}
+
+			if (has_collided)
+			{
+				body->position() += body->position_correction_;
+				body->velocity() += body->velocity_correction_;
+
+				body->position_correction_ = Vector2f(0.0f, 0.0f);
+				body->velocity_correction_ = Vector2f(0.0f, 0.0f);
+
+				// the rest of the step goes on with the new velocity
+				delta_position = get_substep_move(body, delta_time);
+			}
+		}
+
+		body->position() += delta_position;
+
+		update_extents(body);
+
+		broadphase_->update_body(body);
+
+		body->substep_count_ = 1;
+		first_contact = last_contact;
+	}
+
+	substepped_bodies_.clear();
+	substep_contacts_.clear();
+}
+
+Vector2f Physics_Engine::get_substep_move(Body* body, float delta_time) const
+{
+	Vector2f delta_position = body->velocity() * (delta_time / body->substep_count_);
+
+	// with the count capped by max_substep_count a longer move could leave the
+	// centre of the body past the middle of a thin body, which pushes it out on
+	// the far side
+	float half_size = get_substep_size(body->shape_);
+	float distance_squared = delta_position.dot(delta_position);
+	if (distance_squared > half_size * half_size)
+	{
+		delta_position = delta_position * (half_size / sqrtf(distance_squared));
+	}
+
+	return delta_position;
+}
+
+float Physics_Engine::get_substep_size(const Shape* shape)
+{
+	return 0.5f * std::min(shape->get_max_x() - shape->get_min_x(), shape->get_max_y() - shape->get_min_y());
+}
+
+void Physics_Engine::update_extents(Body* body)
+{
+	body->min_x() = body->position().x + body->shape_->get_min_x();
+	body->max_x() = body->position().x + body->shape_->get_max_x();
+	body->min_y() = body->position().y + body->shape_->get_min_y();
+	body->max_y() = body->position().y + body->shape_->get_max_y();
+}
+
+void Physics_Engine::expand_to_sweep(Body* body)
+{
+	// the broadphase pairs the body with everything it sweeps through. The
+	// extents are at the end of the move, grow them back to its start.
+	Vector2f delta_position = body->position() - body->previous_position();
+	if (delta_position.x < 0.0f)
+	{
+		body->max_x() -= delta_position.x;
+	}
+	else
+	{
+		body->min_x() -= delta_position.x;
+	}
+
+	if (delta_position.y < 0.0f)
+	{
+		body->max_y() -= delta_position.y;
+	}
+	else
+	{
+		body->min_y() -= delta_position.y;
+	}
+}
+
+void Physics_Engine::begin_sweep(Body* body)
+{
+	continuous_bodies_.push_back(body);
+
+	body->time_of_impact_ = 1.0f;
+	body->impact_body_ = nullptr;
+
+	expand_to_sweep(body);
+}
+
+void Physics_Engine::solve_impacts()
+{
+	for each (auto pair in collect_pairs())
+	{
+		if (pair.body_a->is_continuous_ && pair.body_a->type_ == Body::Type::DYNAMIC && pair.body_a->is_awake_
+			&& pair.body_b->type_ == Body::Type::STATIC)
+		{
+			find_impact(pair.body_a, pair.body_b);
+		}
+		else if (pair.body_b->is_continuous_ && pair.body_b->type_ == Body::Type::DYNAMIC && pair.body_b->is_awake_
+			&& pair.body_a->type_ == Body::Type::STATIC)
+		{
+			find_impact(pair.body_b, pair.body_a);
+		}
+	}
+
+	for each (auto body in continuous_bodies_)
+	{
+		if (body->impact_body_ == nullptr)
+		{
+			continue;
+		}
+
+		// the rest of the step is lost
+		Vector2f start = body->previous_position();
+		body->position() = start + (body->position() - start) * body->time_of_impact_;
+
+		update_extents(body);
+
+		broadphase_->update_body(body);
+
+		// the body touches the other body, remove the velocity towards it
+		const Vector2f& n = body->impact_normal_;
+		float normal_velocity = n.dot(body->velocity());
+		if (normal_velocity < 0.0f)
+		{
+			body->velocity() -= n * normal_velocity * (1.0f + body->bouncing_);
+		}
+
+		Body::Collision collision;
+		collision.collider_body = body->impact_body_;
+		collision.distance = 0.0f;
+		collision.normal = n;
+
+		report_collision(body, collision);
+	}
+
+	continuous_bodies_.clear();
+}
+
+void Physics_Engine::find_impact(Body* dynamic_body, Body* other_body)
+{
+	Vector2f start = dynamic_body->previous_position();
+	Vector2f delta_position = dynamic_body->position() - start;
+
+	float radius = 0.0f;
+	float height = 0.0f;
+	if (!get_cast_size(dynamic_body->shape_, radius, height))
+	{
+		return;
+	}
+
+	// a slow body can't pass through anything
+	if (delta_position.dot(delta_position) < radius * radius)
+	{
+		return;
+	}
+
+	float time = dynamic_body->time_of_impact_;
+	Vector2f normal;
+	if (cast_against(start, delta_position, radius, height, other_body, time, normal))
+	{
+		dynamic_body->time_of_impact_ = time;
+		dynamic_body->impact_normal_ = normal;
+		dynamic_body->impact_body_ = other_body;
+	}
+}
+
+bool Physics_Engine::cast(const Vector2f& start, const Vector2f& end, float radius, float height, Cast_Mode mode, Cast_Hit& hit, std::vector<Cast_Hit>* hits)
+{
+	Vector2f delta_position = end - start;
+
+	update_static_index();
+
+	float min_x = std::min(start.x, end.x) - radius;
+	float min_y = std::min(start.y, end.y) - radius;
+	float max_x = std::max(start.x, end.x) + radius;
+	float max_y = std::max(start.y, end.y) + radius + height;
+
+	query_bodies_.clear();
+	broadphase_->query(min_x, min_y, max_x, max_y, query_bodies_);
+	static_index_.query(min_x, min_y, max_x, max_y, query_bodies_);
+
+	size_t first_hit = hits != nullptr ? hits->size() : 0;
+	bool has_hit = false;
+	hit.fraction = 1.0f;
+
+	for each (auto body in query_bodies_)
+	{
+		// the closest hit so far bounds the search
+		float time = mode == Cast_Mode::CLOSEST ? hit.fraction : 1.0f;
+		Vector2f normal;
+		if (!cast_against(start, delta_position, radius, height, body, time, normal))
+		{
+			continue;
+		}
+
+		has_hit = true;
+
+		hit.body = body;
+		hit.fraction = time;
+		hit.position = start + delta_position * time;
+		hit.normal = normal;
+
+		if (mode == Cast_Mode::ANY)
+		{
+			break;
+		}
+
+		if (mode == Cast_Mode::ALL)
+		{
+			hits->push_back(hit);
+			hit.fraction = 1.0f;
+		}
+	}
+
+	if (hits != nullptr)
+	{
+		std::sort(hits->begin() + first_hit, hits->end(),
+			[](const Cast_Hit& a, const Cast_Hit& b) { return a.fraction < b.fraction; });
+	}
+
+	return has_hit;
+}
+
+bool Physics_Engine::get_cast_size(const Shape* shape, float& radius, float& height)
+{
+	switch (shape->type_)
+	{
+	case Shape::Type::CIRCLE:
+		radius = static_cast<const Circle_Shape*>(shape)->radius_;
+		height = 0.0f;
+		return true;
+	case Shape::Type::CAPSULE:
+		radius = static_cast<const Capsule_Shape*>(shape)->radius_;
+		height = static_cast<const Capsule_Shape*>(shape)->distance_;
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool Physics_Engine::cast_against(const Vector2f& start, const Vector2f& delta_position, float radius, float height, Body* body, float& time, Vector2f& normal)
+{
+	// the cast capsule (a circle if height is 0, a ray if radius is 0 too)
+	// moves along the segment from start to start + delta_position, its shape
+	// is added to the shape of the body
+	bool has_impact = false;
+
+	const Vector2f& position = body->position();
+	switch (body->shape_->type_)
+	{
+	case Shape::Type::BOX:
+	{
+		Box_Shape* shape = static_cast<Box_Shape*>(body->shape_);
+
+		Vector2f min(position.x - shape->half_width_ - radius, position.y - shape->half_height_ - radius - height);
+		Vector2f max(position.x + shape->half_width_ + radius, position.y + shape->half_height_ + radius);
+		has_impact = intersect_segment_box(start, delta_position, min, max, time, normal);
+		break;
+	}
+	case Shape::Type::CIRCLE:
+	case Shape::Type::CAPSULE:
+	{
+		float body_radius = 0.0f;
+		float body_height = 0.0f;
+		get_cast_size(body->shape_, body_radius, body_height);
+
+		float total_radius = radius + body_radius;
+
+		// the segment between the centers of the bottom circle and the top
+		// circle of the sum of the two shapes
+		Vector2f bottom(position.x, position.y - height);
+		Vector2f top(position.x, position.y + body_height);
+
+		has_impact = intersect_segment_circle(start, delta_position, top, total_radius, time, normal);
+		if (top.y > bottom.y)
+		{
+			has_impact |= intersect_segment_circle(start, delta_position, bottom, total_radius, time, normal);
+
+			Vector2f min(position.x - total_radius, bottom.y);
+			Vector2f max(position.x + total_radius, top.y);
+			has_impact |= intersect_segment_box(start, delta_position, min, max, time, normal);
+		}
+		break;
+	}
+	case Shape::Type::CHAIN:
+	{
+		Chain_Shape* shape = static_cast<Chain_Shape*>(body->shape_);
+		const std::vector<Chain_Shape::Segment>& segments = shape->segments_;
+
+		float min_x = std::min(start.x, start.x + delta_position.x) - radius - position.x;
+		float max_x = std::max(start.x, start.x + delta_position.x) + radius - position.x;
+
+		for (size_t i = shape->find_first_segment(min_x); i < segments.size(); i++)
+		{
+			const Chain_Shape::Segment& segment = segments[i];
+			if (segment.center.x - segment.half_width > max_x)
+			{
+				break;
+			}
+
+			Vector2f center = segment.center + position;
+			Vector2f min(center.x - segment.half_width - radius, center.y - segment.half_height - radius - height);
+			Vector2f max(center.x + segment.half_width + radius, center.y + segment.half_height + radius);
+			has_impact |= intersect_segment_box(start, delta_position, min, max, time, normal);
+		}
+		break;
+	}
+	default:
+		break;
+	}
+
+	return has_impact;
+}
+
+void Physics_Engine::update_sleep(Body* body, float delta_time)
+{
+	// the body is at rest if it has almost no velocity and the step, corrections
+	// included, has barely moved it
+	float max_velocity = settings_.sleep_velocity;
+	float max_distance = settings_.sleep_velocity * delta_time;
+
+	const Vector2f& velocity = body->velocity();
+	Vector2f displacement = body->position() - body->previous_position();
+
+	if (velocity.x * velocity.x + velocity.y * velocity.y > max_velocity * max_velocity
+		|| displacement.x * displacement.x + displacement.y * displacement.y > max_distance * max_distance)
+	{
+		body->sleep_time_ = 0.0f;
+		return;
+	}
+
+	body->sleep_time_ += delta_time;
+	if (body->sleep_time_ < settings_.time_to_sleep)
+	{
+		return;
+	}
+
+	body->is_awake_ = false;
+	body->velocity() = Vector2f(0.0f, 0.0f);
+	body->previous_position() = body->position();
+
+	if (body->arrays_ != nullptr)
+	{
+		body_arrays_.put_to_sleep(body);
+	}
+}
+
+void Physics_Engine::wake_up_paired_bodies(Body* body)
+{
+	// the broadphase finds the bodies around the body without going through
+	// every pair
+	query_bodies_.clear();
+	broadphase_->query(body->min_x(), body->min_y(), body->max_x(), body->max_y(), query_bodies_);
+
+	for each (auto other_body in query_bodies_)
+	{
+		if (other_body != body && other_body->type_ == Body::Type::DYNAMIC)
+		{
+			other_body->wake_up();
+		}
+	}
+}
+
+float Physics_Engine::get_alpha() const
+{
+	return accumulator_ / settings_.fixed_delta_time;
+}
+
+Body_Handle Physics_Engine::create_body(Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity)
+{
+	uint32_t slot = allocate_body_slot();
+
+	Body* body = construct_body(slot, type, position, shape, collision_callback, entity);
+	insert_body(body, slot);
+	add_to_broadphase(body);
+
+	return body->handle_;
+}
+
+bool Physics_Engine::destroy_body(Body_Handle handle)
+{
+	Body* body = get_body(handle);
+	if (body == nullptr)
+	{
+		return false;
+	}
+
+	remove_body(body);
+	return true;
+}
+
+Body* Physics_Engine::get_body(Body_Handle handle) const
+{
+	if (handle.index >= body_slots_.size() || body_slots_[handle.index].generation != handle.generation)
+	{
+		return nullptr;
+	}
+
+	return body_slots_[handle.index].body;
+}
+
+Body_Handle Physics_Engine::queue_create_body(Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity)
+{
+	Command command;
+	command.type = Command_Type::CREATE_BODY;
+	command.vector = position;
+	command.shape = shape;
+	command.body_type = type;
+	command.collision_callback = collision_callback;
+	command.entity = entity;
+
+	std::lock_guard<std::mutex> lock(command_mutex_);
+
+	command.handle.index = reserve_body_slot();
+	command.handle.generation = command.handle.index < body_slots_.size() ? body_slots_[command.handle.index].generation : 1;
+	commands_.push_back(command);
+
+	return command.handle;
+}
+
+void Physics_Engine::queue_destroy_body(Body_Handle handle)
+{
+	Command command;
+	command.type = Command_Type::DESTROY_BODY;
+	command.handle = handle;
+	queue_command(command);
+}
+
+void Physics_Engine::queue_move_body(Body_Handle handle, const Vector2f& delta_position)
+{
+	Command command;
+	command.type = Command_Type::MOVE_BODY;
+	command.handle = handle;
+	command.vector = delta_position;
+	queue_command(command);
+}
+
+void Physics_Engine::queue_set_velocity(Body_Handle handle, const Vector2f& velocity)
+{
+	Command command;
+	command.type = Command_Type::SET_VELOCITY;
+	command.handle = handle;
+	command.vector = velocity;
+	queue_command(command);
+}
+
+void Physics_Engine::queue_set_shape(Body_Handle handle, Shape* shape)
+{
+	Command command;
+	command.type = Command_Type::SET_SHAPE;
+	command.handle = handle;
+	command.shape = shape;
+	queue_command(command);
+}
+
+void Physics_Engine::queue_command(const Command& command)
+{
+	std::lock_guard<std::mutex> lock(command_mutex_);
+	commands_.push_back(command);
+}
+
+void Physics_Engine::apply_commands()
+{
+	{
+		std::lock_guard<std::mutex> lock(command_mutex_);
+		if (commands_.empty())
+		{
+			return;
+		}
+
+		std::swap(commands_, applied_commands_);
+
+		// the queued bodies get their slots, still empty
+		if (reserved_slot_count_ > 0)
+		{
+			Body_Slot slot;
+			slot.body = nullptr;
+			slot.generation = 1;
+			slot.next_free_slot = null_index;
+			slot.is_owned = false;
+			body_slots_.resize(body_slots_.size() + reserved_slot_count_, slot);
+
+			reserved_slot_count_ = 0;
+		}
+	}
+
+	// creations first, then the changes and the destructions of each body in
+	// the order they were queued
+	std::stable_sort(applied_commands_.begin(), applied_commands_.end(),
+		[](const Command& a, const Command& b)
+	{
+		bool is_a_created = a.type == Command_Type::CREATE_BODY;
+		bool is_b_created = b.type == Command_Type::CREATE_BODY;
+		if (is_a_created != is_b_created)
+		{
+			return is_a_created;
+		}
+
+		bool is_a_destroyed = a.type == Command_Type::DESTROY_BODY;
+		bool is_b_destroyed = b.type == Command_Type::DESTROY_BODY;
+		if (is_a_destroyed != is_b_destroyed)
+		{
+			return is_b_destroyed;
+		}
+
+		return a.handle.index < b.handle.index;
+	});
+
+	// the created bodies enter the broadphase together
+	size_t i = 0;
+	for (; i < applied_commands_.size() && applied_commands_[i].type == Command_Type::CREATE_BODY; i++)
+	{
+		Command& command = applied_commands_[i];
+
+		Body* body = construct_body(command.handle.index, command.body_type, command.vector, command.shape, command.collision_callback, command.entity);
+		insert_body(body, command.handle.index);
+		created_bodies_.push_back(body);
+	}
+
+	add_to_broadphase(created_bodies_.data(), created_bodies_.size());
+	created_bodies_.clear();
+
+	for (; i < applied_commands_.size(); i++)
+	{
+		Command& command = applied_commands_[i];
+
+		// the body may be gone already
+		Body* body = get_body(command.handle);
+		if (body == nullptr)
+		{
+			if (command.type == Command_Type::SET_SHAPE)
+			{
+				delete command.shape;
+			}
+
+			continue;
+		}
+
+		switch (command.type)
+		{
+		case Command_Type::MOVE_BODY:
+			move_body(body, command.vector);
+			break;
+		case Command_Type::SET_VELOCITY:
+			body->set_velocity(command.vector);
+			break;
+		case Command_Type::SET_SHAPE:
+			set_shape(body, command.shape);
+			break;
+		case Command_Type::DESTROY_BODY:
+			remove_body(body);
+			break;
+		default:
+			break;
+		}
+	}
+
+	applied_commands_.clear();
+}
+
+uint32_t Physics_Engine::allocate_body_slot()
 {
+	std::lock_guard<std::mutex> lock(command_mutex_);
+
+	uint32_t index = reserve_body_slot();
+
+	// the slots reserved for queued bodies stay empty until they are created
+	if (index >= body_slots_.size())
+	{
+		Body_Slot slot;
+		slot.body = nullptr;
+		slot.generation = 1;
+		slot.next_free_slot = null_index;
+		slot.is_owned = false;
+		body_slots_.resize(body_slots_.size() + reserved_slot_count_, slot);
+
+		reserved_slot_count_ = 0;
+	}
+
+	return index;
 }
 
-void Physics_Engine::update(float delta_time)
+uint32_t Physics_Engine::reserve_body_slot()
 {
-	// update velocity and position of dynamic bodies.
-	// update binary tree.
-	for each (auto ball in dynamic_body_balls_)
+	if (first_free_slot_ == null_index)
 	{
-		Body* body = ball->body;
+		reserved_slot_count_++;
+		return static_cast<uint32_t>(body_slots_.size() + reserved_slot_count_ - 1);
+	}
+
+	uint32_t index = first_free_slot_;
+	first_free_slot_ = body_slots_[index].next_free_slot;
 
-		// add gravity effect to impulse
-		body->impulse_ += gravity_ * delta_time;
+	body_slots_[index].is_owned = false;
+
+	return index;
+}
 
-		// update velocity
-		body->velocity_ += body->impulse_;
+void Physics_Engine::release_body_slot(uint32_t index)
+{
+	Body_Slot& slot = body_slots_[index];
 
-		// update position
-		body->position_ += body->velocity_ * delta_time;
+	if (slot.is_owned)
+	{
+		slot.body->~Body();
+	}
+	else
+	{
+		delete slot.body;
+	}
 
-		// clear impulse
-		body->impulse_ = Vector2f(0.0f, 0.0f);
+	std::lock_guard<std::mutex> lock(command_mutex_);
 
-		// update min_x and max_x
-		body->min_x_ = body->position_.x + body->shape_->get_min_x();
-		body->max_x_ = body->position_.x + body->shape_->get_max_x();
+	// the handles of the slot become stale
+	slot.body = nullptr;
+	slot.generation++;
+	if (slot.generation == 0)
+	{
+		slot.generation = 1;
+	}
 
+	slot.next_free_slot = first_free_slot_;
+	first_free_slot_ = index;
+}
 
-		// update binary tree
-		binary_tree_.update(ball);
+Body* Physics_Engine::construct_body(uint32_t slot, Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity)
+{
+	size_t block = slot / body_block_size;
+	if (block >= body_blocks_.size())
+	{
+		body_blocks_.resize(block + 1, nullptr);
 	}
 
-	// for each dynamic body detect collisions and solve them
-	for each (auto ball in dynamic_body_balls_)
+	if (body_blocks_[block] == nullptr)
 	{
-		detect_and_solve_collision(ball->body, ball->bodies, delta_time);
+		body_blocks_[block] = static_cast<Body*>(::operator new(sizeof(Body) * body_block_size));
 	}
+
+	Body* body = new (body_blocks_[block] + slot % body_block_size) Body(type, position, shape, collision_callback, entity);
+	body_slots_[slot].is_owned = true;
+
+	return body;
 }
 
 void Physics_Engine::add_body(Body* body)
 {
-	// create a new ball with the body
-	BinaryTree::Ball* ball = new BinaryTree::Ball(body);
+	insert_body(body, allocate_body_slot());
+	add_to_broadphase(body);
+}
+
+void Physics_Engine::add_bodies(Body* const* bodies, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+		insert_body(bodies[i], allocate_body_slot());
+	}
+
+	add_to_broadphase(bodies, count);
+}
 
-	// add the ball to the appropriate vector
+void Physics_Engine::insert_body(Body* body, uint32_t slot)
+{
+	body_slots_[slot].body = body;
+	body->handle_.index = slot;
+	body->handle_.generation = body_slots_[slot].generation;
+
+	body->id_ = next_body_id_++;
+
+	// add the body to the appropriate vector
 	if (body->type_ == Body::Type::DYNAMIC)
 	{
-		dynamic_body_balls_.push_back(ball);
+		body->list_index_ = dynamic_bodies_.size();
+		dynamic_bodies_.push_back(body);
+
+		if (settings_.use_body_arrays)
+		{
+			body_arrays_.add(body);
+		}
 	}
 	else
 	{
-		static_body_balls_.push_back(ball);
+		body->list_index_ = static_bodies_.size();
+		static_bodies_.push_back(body);
 	}
-
-	// add the ball to the binary tree
-	binary_tree_.add_ball(ball);
 }
 
 void Physics_Engine::remove_body(Body* body)
 {
-	auto& balls = body->type_ == Body::Type::DYNAMIC ? dynamic_body_balls_ : static_body_balls_;
+	// the body must be in this engine
+	if (get_body(body->handle_) != body)
+	{
+		return;
+	}
 
-	for (auto it = balls.begin(); it != balls.end(); it++)
+	// the bodies resting on the removed body must fall
+	if (settings_.allow_sleeping)
 	{
-		if ((*it)->body == body)
-		{
-			binary_tree_.remove_ball(*it);
+		wake_up_paired_bodies(body);
+	}
 
-			balls.erase(it);
+	remove_from_broadphase(body);
 
-			delete body;
-			return;
-		}
+	// the contacts of a deleted body end for the bodies it touched
+	if (settings_.track_contacts)
+	{
+		forget_contacts(body);
+	}
+
+	// the last body takes the place of the removed one
+	auto& bodies = body->type_ == Body::Type::DYNAMIC ? dynamic_bodies_ : static_bodies_;
+	bodies[body->list_index_] = bodies.back();
+	bodies[body->list_index_]->list_index_ = body->list_index_;
+	bodies.pop_back();
+
+	if (body->arrays_ != nullptr)
+	{
+		body_arrays_.remove(body);
 	}
+
+	release_body_slot(body->handle_.index);
 }
 
 void Physics_Engine::move_body(Body* body, const Vector2f& delta_position)
 {
-	body->position_.y += delta_position.y;
+	if (settings_.allow_sleeping)
+	{
+		body->wake_up();
+		wake_up_paired_bodies(body);
+	}
+
+	// the body is teleported, don't interpolate the move
+	body->previous_position() += delta_position;
+
+	body->position() += delta_position;
+	body->min_x() += delta_position.x;
+	body->max_x() += delta_position.x;
+	body->min_y() += delta_position.y;
+	body->max_y() += delta_position.y;
+
+	if (is_in_static_index(body))
+	{
+		is_static_index_dirty_ = true;
+	}
+	else if (fabsf(delta_position.x) <= broadphase_->get_max_update_distance())
+	{
+		broadphase_->update_body(body);
+	}
+	else
+	{
+		broadphase_->remove_body(body);
+		broadphase_->add_body(body);
+	}
+
+	if (settings_.allow_sleeping)
+	{
+		wake_up_paired_bodies(body);
+	}
+}
+
+void Physics_Engine::set_shape(Body* body, Shape* shape)
+{
+	delete body->shape_;
+	body->shape_ = shape;
 
-	if (delta_position.x != 0.0f)
+	if (body->arrays_ != nullptr)
+	{
+		body_arrays_.update_shape(body);
+	}
+	else
 	{
-		auto& balls = body->type_ == Body::Type::DYNAMIC ? dynamic_body_balls_ : static_body_balls_;
+		update_extents(body);
+	}
 
-		for (auto it = balls.begin(); it != balls.end(); it++)
-		{
-			if ((*it)->body == body)
-			{
-				binary_tree_.remove_ball(*it);
+	// the extents may grow by more than update_body handles
+	remove_from_broadphase(body);
+	add_to_broadphase(body);
 
-				body->position_.x += delta_position.x;
+	if (body->type_ == Body::Type::DYNAMIC)
+	{
+		body->wake_up();
+	}
+}
 
-				binary_tree_.add_ball(*it);
+bool Physics_Engine::is_in_static_index(const Body* body) const
+{
+	return settings_.separate_static_bodies && body->type_ != Body::Type::DYNAMIC;
+}
 
-				return;
-			}
+void Physics_Engine::add_to_broadphase(Body* body)
+{
+	if (is_in_static_index(body))
+	{
+		is_static_index_dirty_ = true;
+		return;
+	}
+
+	broadphase_->add_body(body);
+}
+
+void Physics_Engine::add_to_broadphase(Body* const* bodies, size_t count)
+{
+	if (!settings_.separate_static_bodies)
+	{
+		broadphase_->add_bodies(bodies, count);
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+	{
+		if (is_in_static_index(bodies[i]))
+		{
+			is_static_index_dirty_ = true;
+		}
+		else
+		{
+			broadphase_bodies_.push_back(bodies[i]);
 		}
 	}
+
+	broadphase_->add_bodies(broadphase_bodies_.data(), broadphase_bodies_.size());
+	broadphase_bodies_.clear();
+}
+
+void Physics_Engine::remove_from_broadphase(Body* body)
+{
+	if (is_in_static_index(body))
+	{
+		is_static_index_dirty_ = true;
+		return;
+	}
+
+	broadphase_->remove_body(body);
 }
 
-bool Physics_Engine::fast_detect_collision(Body* dynamic_body, Body* collider_body)
+void Physics_Engine::update_static_index()
 {
-	return (dynamic_body->min_x_ < collider_body->max_x_) && (dynamic_body->max_x_ > collider_body->min_x_);
+	if (!is_static_index_dirty_)
+	{
+		return;
+	}
+
+	static_index_.build(static_bodies_);
+	is_static_index_dirty_ = false;
 }
 
-void Physics_Engine::detect_and_solve_collision(Body* dynamic_body, std::vector<Body*>& other_bodies, float deltaTime)
+void Physics_Engine::find_static_pairs()
 {
-	Vector2f position_correction(0.0f, 0.0f);
-	Vector2f velocity_correction(0.0f, 0.0f);
-	for each (auto body in other_bodies)
+	static_pairs_.clear();
+
+	for each (auto body in dynamic_bodies_)
 	{
-		if (!fast_detect_collision(dynamic_body, body))
+		if (!body->is_awake_)
 		{
 			continue;
 		}
 
-		if (dynamic_body->shape_->type_ == Shape::Type::CIRCLE)
+		query_bodies_.clear();
+		static_index_.query(body->min_x(), body->min_y(), body->max_x(), body->max_y(), query_bodies_);
+
+		for each (auto static_body in query_bodies_)
 		{
-			if (body->shape_->type_ == Shape::Type::BOX)
-			{
-				detect_and_solve_circle_box_collision(dynamic_body, body, position_correction, velocity_correction);
-			}
-			else if (body->shape_->type_ == Shape::Type::CIRCLE)
+			if (Broadphase::can_pair(body, static_body))
 			{
-				detect_and_solve_circle_circle_collision(dynamic_body, body, position_correction, velocity_correction);
-			}
-			else if (body->shape_->type_ == Shape::Type::CHAIN)
-			{
-				detect_and_solve_circle_chain_collision(dynamic_body, body, position_correction, velocity_correction);
+				static_pairs_.push_back(Pair_Cache::create_pair(body, static_body));
 			}
 		}
-		else if (dynamic_body->shape_->type_ == Shape::Type::CAPSULE)
+	}
+}
+
+const std::vector<Pair_Cache::Pair>& Physics_Engine::collect_pairs()
+{
+	const auto& pairs = broadphase_->get_pair_cache().get_pairs();
+	if (!settings_.separate_static_bodies)
+	{
+		return pairs;
+	}
+
+	step_pairs_.assign(pairs.begin(), pairs.end());
+	step_pairs_.insert(step_pairs_.end(), static_pairs_.begin(), static_pairs_.end());
+
+	return step_pairs_;
+}
+
+bool Physics_Engine::fast_detect_collision(Body* dynamic_body, Body* collider_body)
+{
+	return (dynamic_body->min_x() < collider_body->max_x()) && (dynamic_body->max_x() > collider_body->min_x())
+		&& (dynamic_body->min_y() < collider_body->max_y()) && (dynamic_body->max_y() > collider_body->min_y());
+}
+
+void Physics_Engine::detect_and_solve_circle_box_collisions(Contact* contacts, const uint32_t* contact_indices, size_t count)
+{
+	// reject the contacts whose shapes don't overlap with squared distances,
+	// the full kernel runs only on the others
+	size_t i = 0;
+
+#ifdef PHYSICS_ENGINE_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		float delta_x[4];
+		float delta_y[4];
+		float half_width[4];
+		float half_height[4];
+		float radius[4];
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			const Contact& contact = contacts[contact_indices[i + j]];
+			const Box_Shape* box_shape = static_cast<const Box_Shape*>(contact.other_body->shape_);
+
+			delta_x[j] = contact.dynamic_body->position().x - contact.other_body->position().x;
+			delta_y[j] = contact.dynamic_body->position().y - contact.other_body->position().y;
+			half_width[j] = box_shape->half_width_;
+			half_height[j] = box_shape->half_height_;
+			radius[j] = static_cast<const Circle_Shape*>(contact.dynamic_body->shape_)->radius_;
+		}
+
+		__m128 d_x = _mm_loadu_ps(delta_x);
+		__m128 d_y = _mm_loadu_ps(delta_y);
+		__m128 h_w = _mm_loadu_ps(half_width);
+		__m128 h_h = _mm_loadu_ps(half_height);
+		__m128 r = _mm_loadu_ps(radius);
+
+		// distance from the closest point of the box
+		__m128 n_x = _mm_sub_ps(d_x, _mm_min_ps(_mm_max_ps(d_x, _mm_sub_ps(_mm_setzero_ps(), h_w)), h_w));
+		__m128 n_y = _mm_sub_ps(d_y, _mm_min_ps(_mm_max_ps(d_y, _mm_sub_ps(_mm_setzero_ps(), h_h)), h_h));
+		__m128 squared_distance = _mm_add_ps(_mm_mul_ps(n_x, n_x), _mm_mul_ps(n_y, n_y));
+
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(squared_distance, _mm_mul_ps(r, r)));
+
+		for (size_t j = 0; j < 4; j++)
 		{
-			if (body->shape_->type_ == Shape::Type::BOX)
-			{
-				detect_and_solve_capsule_box_collision(dynamic_body, body, position_correction, velocity_correction);
-			}
-			else if (body->shape_->type_ == Shape::Type::CIRCLE)
-			{
-				detect_and_solve_capsule_circle_collision(dynamic_body, body, position_correction, velocity_correction);
-			}
-			else if (body->shape_->type_ == Shape::Type::CHAIN)
-			{
-				detect_and_solve_capsule_chain_collision(dynamic_body, body, position_correction, velocity_correction);
-			}
+			Contact& contact = contacts[contact_indices[i + j]];
+			contact.has_collided = (mask & (1 << j)) != 0 && detect_and_solve_circle_box_collision(contact.dynamic_body, contact.other_body,
+				contact.position_correction, contact.velocity_correction, contact.collision);
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		Contact& contact = contacts[contact_indices[i]];
+		const Box_Shape* box_shape = static_cast<const Box_Shape*>(contact.other_body->shape_);
+
+		float delta_x = contact.dynamic_body->position().x - contact.other_body->position().x;
+		float delta_y = contact.dynamic_body->position().y - contact.other_body->position().y;
+		float radius = static_cast<const Circle_Shape*>(contact.dynamic_body->shape_)->radius_;
+
+		float n_x = delta_x - clamp<float>(delta_x, -box_shape->half_width_, box_shape->half_width_);
+		float n_y = delta_y - clamp<float>(delta_y, -box_shape->half_height_, box_shape->half_height_);
+
+		contact.has_collided = n_x * n_x + n_y * n_y < radius * radius && detect_and_solve_circle_box_collision(contact.dynamic_body, contact.other_body,
+			contact.position_correction, contact.velocity_correction, contact.collision);
+	}
+}
+
+void Physics_Engine::detect_and_solve_circle_circle_collisions(Contact* contacts, const uint32_t* contact_indices, size_t count)
+{
+	// reject the contacts whose shapes don't overlap with squared distances,
+	// the full kernel runs only on the others
+	size_t i = 0;
+
+#ifdef PHYSICS_ENGINE_SSE2
+	for (; i + 4 <= count; i += 4)
+	{
+		float delta_x[4];
+		float delta_y[4];
+		float radius[4];
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			const Contact& contact = contacts[contact_indices[i + j]];
+
+			delta_x[j] = contact.dynamic_body->position().x - contact.other_body->position().x;
+			delta_y[j] = contact.dynamic_body->position().y - contact.other_body->position().y;
+			radius[j] = static_cast<const Circle_Shape*>(contact.dynamic_body->shape_)->radius_
+				+ static_cast<const Circle_Shape*>(contact.other_body->shape_)->radius_;
+		}
+
+		__m128 d_x = _mm_loadu_ps(delta_x);
+		__m128 d_y = _mm_loadu_ps(delta_y);
+		__m128 r = _mm_loadu_ps(radius);
+
+		__m128 squared_distance = _mm_add_ps(_mm_mul_ps(d_x, d_x), _mm_mul_ps(d_y, d_y));
+
+		int mask = _mm_movemask_ps(_mm_cmplt_ps(squared_distance, _mm_mul_ps(r, r)));
+
+		for (size_t j = 0; j < 4; j++)
+		{
+			Contact& contact = contacts[contact_indices[i + j]];
+			contact.has_collided = (mask & (1 << j)) != 0 && detect_and_solve_circle_circle_collision(contact.dynamic_body, contact.other_body,
+				contact.position_correction, contact.velocity_correction, contact.collision);
 		}
 	}
+#endif
+
+	for (; i < count; i++)
+	{
+		Contact& contact = contacts[contact_indices[i]];
 
-	dynamic_body->position_ += position_correction;
-	dynamic_body->velocity_ += velocity_correction;
+		float delta_x = contact.dynamic_body->position().x - contact.other_body->position().x;
+		float delta_y = contact.dynamic_body->position().y - contact.other_body->position().y;
+		float radius = static_cast<const Circle_Shape*>(contact.dynamic_body->shape_)->radius_
+			+ static_cast<const Circle_Shape*>(contact.other_body->shape_)->radius_;
+
+		contact.has_collided = delta_x * delta_x + delta_y * delta_y < radius * radius && detect_and_solve_circle_circle_collision(contact.dynamic_body, contact.other_body,
+			contact.position_correction, contact.velocity_correction, contact.collision);
+	}
 }
 
-void Physics_Engine::detect_and_solve_circle_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_circle_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Circle_Shape* dynamic_body_shape = static_cast<Circle_Shape*>(dynamic_body->shape_);
 	Box_Shape* other_body_shape = static_cast<Box_Shape*>(other_body->shape_);
 
-	Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+	Vector2f delta_position = dynamic_body->position() - other_body->position();
 
 	Vector2f v = delta_position;
 	v.x = clamp<float>(v.x, -other_body_shape->half_width_, other_body_shape->half_width_);
@@ -171,91 +2082,88 @@ void Physics_Engine::detect_and_solve_circle_box_collision(Body* dynamic_body, B
 	float distance = n.compute_length() - dynamic_body_shape->radius_;
 	if (distance >= 0.0f)
 	{
-		return;
+		return false;
 	}
 
-	if (other_body->type_ == Body::Type::STATIC)
+	if (other_body->type_ != Body::Type::SENSOR)
 	{
-		position_correction -= n.normalize() * distance;
+		position_correction -= normalize_normal(n) * distance;
 
-		Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+		Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 		velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 		Vector2f p = n.ortho();
 		velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 	}
 
-	if (dynamic_body->collision_callback_ != nullptr)
-	{
-		Body::Collision collision;
-		collision.collider_body = other_body;
-		collision.distance = distance;
-		collision.normal = n;
+	collision.collider_body = other_body;
+	collision.distance = distance;
+	collision.normal = n;
 
-		dynamic_body->collision_callback_(collision);
-	}
+	return true;
 }
 
-void Physics_Engine::detect_and_solve_circle_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_circle_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Circle_Shape* dynamic_body_shape = static_cast<Circle_Shape*>(dynamic_body->shape_);
 	Circle_Shape* other_body_shape = static_cast<Circle_Shape*>(other_body->shape_);
 
-	Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+	Vector2f delta_position = dynamic_body->position() - other_body->position();
 
 	float distance = delta_position.compute_length() - (dynamic_body_shape->radius_ + other_body_shape->radius_);
 	if (distance >= 0.0f)
 	{
-		return;
+		return false;
 	}
 
-	Vector2f n = delta_position.normalized();
+	Vector2f n = delta_position;
+	normalize_normal(n);
 
-	if (other_body->type_ == Body::Type::STATIC)
+	if (other_body->type_ != Body::Type::SENSOR)
 	{
 		position_correction -= n * distance;
 
-		Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+		Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 		velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 		Vector2f p = n.ortho();
 		velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 	}
 
-	if (dynamic_body->collision_callback_ != nullptr)
-	{
-		Body::Collision collision;
-		collision.collider_body = other_body;
-		collision.distance = distance;
-		collision.normal = n;
+	collision.collider_body = other_body;
+	collision.distance = distance;
+	collision.normal = n;
 
-		dynamic_body->collision_callback_(collision);
-	}
+	return true;
 }
 
-void Physics_Engine::detect_and_solve_circle_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_circle_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Circle_Shape* dynamic_body_shape = static_cast<Circle_Shape*>(dynamic_body->shape_);
 	Chain_Shape* other_body_shape = static_cast<Chain_Shape*>(other_body->shape_);
 
-	const std::vector<Vector2f>& vertices = other_body_shape->vertices_;
+	const std::vector<Chain_Shape::Segment>& segments = other_body_shape->segments_;
+
+	// only the segments under the body can collide with it
+	float min_x = dynamic_body->min_x() - other_body->position().x;
+	float max_x = dynamic_body->max_x() - other_body->position().x;
 
 	bool has_collided = false;
 	Vector2f p_c(0.0f, 0.0f);
-	for (size_t i = 0; i < vertices.size() - 2; i += 2)
+	for (size_t i = other_body_shape->find_first_segment(min_x); i < segments.size(); i++)
 	{
-		const Vector2f v0(vertices[i].x, vertices[0].y);
-		const Vector2f& v1 = vertices[i + 1];
-		const Vector2f& v2 = vertices[i + 2];
-
-		Vector2f c = (v0 + v2) / 2.0f;
+		const Chain_Shape::Segment& segment = segments[i];
+		if (segment.center.x - segment.half_width > max_x)
+		{
+			break;
+		}
 
-		float half_width = v2.x - c.x;
-		float half_height = v1.y - c.y;
+		float half_width = segment.half_width;
+		float half_height = segment.half_height;
 
-		c += other_body->position_;
+		Vector2f c = segment.center + other_body->position();
 
-		Vector2f delta_position = dynamic_body->position_ - c;
+		Vector2f delta_position = dynamic_body->position() - c;
 
 		Vector2f v = delta_position;
 		v.x = clamp<float>(delta_position.x, -half_width, half_width);
@@ -266,15 +2174,10 @@ void Physics_Engine::detect_and_solve_circle_chain_collision(Body* dynamic_body,
 		float distance = n.compute_length() - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			if (n.x < 0.0f)
-			{
-				break;
-			}
-
 			continue;
 		}
 
-		p_c -= n.normalize() * distance;
+		p_c -= normalize_normal(n) * distance;
 
 		has_collided = true;
 	}
@@ -282,39 +2185,38 @@ void Physics_Engine::detect_and_solve_circle_chain_collision(Body* dynamic_body,
 	if (has_collided)
 	{
 		float distance = p_c.compute_length();
-		Vector2f n = p_c.normalized();
+		Vector2f n = p_c;
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction += p_c;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
+
+	return false;
 }
 
-void Physics_Engine::detect_and_solve_capsule_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_capsule_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Capsule_Shape* dynamic_body_shape = static_cast<Capsule_Shape*>(dynamic_body->shape_);
 	Box_Shape* other_body_shape = static_cast<Box_Shape*>(other_body->shape_);
 
-	if (dynamic_body->position_.y >= other_body->position_.y + other_body_shape->half_height_)
+	if (dynamic_body->position().y >= other_body->position().y + other_body_shape->half_height_)
 	{
-		Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+		Vector2f delta_position = dynamic_body->position() - other_body->position();
 
 		Vector2f v = delta_position;
 		v.x = clamp<float>(delta_position.x, -other_body_shape->half_width_, other_body_shape->half_width_);
@@ -325,35 +2227,31 @@ void Physics_Engine::detect_and_solve_capsule_box_collision(Body* dynamic_body,
 		float distance = n.compute_length() - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		n.normalize();
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
-			position_correction -= n.normalize() * distance;
+			position_correction -= normalize_normal(n) * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
-	else if (dynamic_body->position_.y + dynamic_body_shape->distance_ <= other_body->position_.y - other_body_shape->half_height_)
+	else if (dynamic_body->position().y + dynamic_body_shape->distance_ <= other_body->position().y - other_body_shape->half_height_)
 	{
-		Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+		Vector2f delta_position = dynamic_body->position() - other_body->position();
 		delta_position.y += dynamic_body_shape->distance_;
 
 		Vector2f v = delta_position;
@@ -365,35 +2263,31 @@ void Physics_Engine::detect_and_solve_capsule_box_collision(Body* dynamic_body,
 		float distance = n.compute_length() - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		n.normalize();
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
-			position_correction -= n.normalize() * distance;
+			position_correction -= normalize_normal(n) * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
 	else
 	{
-		float delta_position_x = dynamic_body->position_.x - other_body->position_.x;
+		float delta_position_x = dynamic_body->position().x - other_body->position().x;
 
 		float v_x = clamp<float>(delta_position_x, -other_body_shape->half_width_, other_body_shape->half_width_);
 
@@ -402,109 +2296,99 @@ void Physics_Engine::detect_and_solve_capsule_box_collision(Body* dynamic_body,
 		float distance = fabs(n.x) - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		n.normalize();
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction -= n * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
 }
 
-void Physics_Engine::detect_and_solve_capsule_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_capsule_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Capsule_Shape* dynamic_body_shape = static_cast<Capsule_Shape*>(dynamic_body->shape_);
 	Circle_Shape* other_body_shape = static_cast<Circle_Shape*>(other_body->shape_);
 
-	if (dynamic_body->position_.y >= other_body->position_.y)
+	if (dynamic_body->position().y >= other_body->position().y)
 	{
-		Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+		Vector2f delta_position = dynamic_body->position() - other_body->position();
 
 		float distance = delta_position.compute_length() - (dynamic_body_shape->radius_ + other_body_shape->radius_);
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		Vector2f n = delta_position.normalized();
+		Vector2f n = delta_position;
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction -= n * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
-	else if (dynamic_body->position_.y + dynamic_body_shape->distance_ <= other_body->position_.y)
+	else if (dynamic_body->position().y + dynamic_body_shape->distance_ <= other_body->position().y)
 	{
-		Vector2f delta_position = dynamic_body->position_ - other_body->position_;
+		Vector2f delta_position = dynamic_body->position() - other_body->position();
 		delta_position.y += dynamic_body_shape->distance_;
 
 		float distance = delta_position.compute_length() - (dynamic_body_shape->radius_ + other_body_shape->radius_);
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		Vector2f n = delta_position.normalized();
+		Vector2f n = delta_position;
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction -= n * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
 	else
 	{
-		float delta_position_x = dynamic_body->position_.x - other_body->position_.x;
+		float delta_position_x = dynamic_body->position().x - other_body->position().x;
 
 		float v_x = clamp<float>(delta_position_x, -other_body_shape->radius_, other_body_shape->radius_);
 
@@ -513,57 +2397,57 @@ void Physics_Engine::detect_and_solve_capsule_circle_collision(Body* dynamic_bod
 		float distance = fabs(n.x) - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			return;
+			return false;
 		}
 
-		n.normalize();
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction -= n * distance;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
 }
 
-void Physics_Engine::detect_and_solve_capsule_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction)
+bool Physics_Engine::detect_and_solve_capsule_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision)
 {
 	Capsule_Shape* dynamic_body_shape = static_cast<Capsule_Shape*>(dynamic_body->shape_);
 	Chain_Shape* other_body_shape = static_cast<Chain_Shape*>(other_body->shape_);
 
-	const std::vector<Vector2f>& vertices = other_body_shape->vertices_;
+	const std::vector<Chain_Shape::Segment>& segments = other_body_shape->segments_;
+
+	// only the segments under the body can collide with it
+	float min_x = dynamic_body->min_x() - other_body->position().x;
+	float max_x = dynamic_body->max_x() - other_body->position().x;
 
 	bool has_collided = false;
 	Vector2f p_c(0.0f, 0.0f);
-	for (size_t i = 0; i < vertices.size() - 2; i += 2)
+	for (size_t i = other_body_shape->find_first_segment(min_x); i < segments.size(); i++)
 	{
-		const Vector2f v0(vertices[i].x, vertices[0].y);
-		const Vector2f& v1 = vertices[i + 1];
-		const Vector2f& v2 = vertices[i + 2];
-
-		Vector2f c = (v0 + v2) / 2.0f;
+		const Chain_Shape::Segment& segment = segments[i];
+		if (segment.center.x - segment.half_width > max_x)
+		{
+			break;
+		}
 
-		float half_width = v2.x - c.x;
-		float half_height = v1.y - c.y;
+		float half_width = segment.half_width;
+		float half_height = segment.half_height;
 
-		c += other_body->position_;
+		Vector2f c = segment.center + other_body->position();
 
-		Vector2f delta_position = dynamic_body->position_ - c;
+		Vector2f delta_position = dynamic_body->position() - c;
 
 		Vector2f v = delta_position;
 		v.x = clamp<float>(delta_position.x, -half_width, half_width);
@@ -574,15 +2458,10 @@ void Physics_Engine::detect_and_solve_capsule_chain_collision(Body* dynamic_body
 		float distance = n.compute_length() - dynamic_body_shape->radius_;
 		if (distance >= 0.0f)
 		{
-			if (n.x < 0.0f)
-			{
-				break;
-			}
-
 			continue;
 		}
 
-		p_c -= n.normalize() * distance;
+		p_c -= normalize_normal(n) * distance;
 
 		has_collided = true;
 	}
@@ -590,27 +2469,26 @@ void Physics_Engine::detect_and_solve_capsule_chain_collision(Body* dynamic_body
 	if (has_collided)
 	{
 		float distance = p_c.compute_length();
-		Vector2f n = p_c.normalized();
+		Vector2f n = p_c;
+		normalize_normal(n);
 
-		if (other_body->type_ == Body::Type::STATIC)
+		if (other_body->type_ != Body::Type::SENSOR)
 		{
 			position_correction += p_c;
 
-			Vector2f delta_velocity = dynamic_body->velocity_ - other_body->velocity_;
+			Vector2f delta_velocity = dynamic_body->velocity() - other_body->velocity();
 			velocity_correction -= n * n.dot(delta_velocity) * (1.0f + dynamic_body->bouncing_);
 
 			Vector2f p = n.ortho();
 			velocity_correction -= p * p.dot(delta_velocity) * dynamic_body->friction_ * other_body->friction_ * 0.03f;
 		}
 
-		if (dynamic_body->collision_callback_ != nullptr)
-		{
-			Body::Collision collision;
-			collision.collider_body = other_body;
-			collision.distance = distance;
-			collision.normal = n;
+		collision.collider_body = other_body;
+		collision.distance = distance;
+		collision.normal = n;
 
-			dynamic_body->collision_callback_(collision);
-		}
+		return true;
 	}
+
+	return false;
 }
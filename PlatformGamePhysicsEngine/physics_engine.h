@@ -1,32 +1,402 @@
 #pragma once
 
+#include <functional>
+#include <mutex>
+#include <unordered_map>
 #include "binary_tree.h"
+#include "sort_and_sweep.h"
+#include "static_index.h"
+#include "uniform_grid.h"
+#include "body_arrays.h"
+#include "thread_pool.h"
 
 class Physics_Engine
 {
 public:
-	Physics_Engine(const Vector2f& gravity);
+	enum Broadphase_Type
+	{
+		BINARY_TREE,
+		SORT_AND_SWEEP,
+		UNIFORM_GRID
+	};
+
+	struct Settings
+	{
+		// keep the state of dynamic bodies in contiguous arrays
+		bool use_body_arrays;
+
+		Broadphase_Type broadphase_type;
+
+		// side of the cells of the uniform grid broadphase
+		float grid_cell_size;
+
+		// time step used by step()
+		float fixed_delta_time;
+		// maximum number of fixed steps run by a single call to step(), the
+		// remaining time is dropped to avoid falling further and further behind
+		size_t max_step_count;
+
+		// let dynamic bodies at rest for time_to_sleep seconds fall asleep. A
+		// body is at rest while its speed stays below sleep_velocity.
+		bool allow_sleeping;
+		float sleep_velocity;
+		float time_to_sleep;
+
+		// threads helping the calling thread in the narrowphase, 0 runs it
+		// serially. Callbacks are always run on the calling thread.
+		size_t worker_thread_count;
+
+		// a dynamic body moving more than half its size in a step is moved in
+		// up to max_substep_count substeps, each one tested against the static
+		// bodies around it. 1 moves every body in a single step. A substep
+		// never moves more than half the size of the body, a body faster than
+		// that covers less than its velocity in the step.
+		size_t max_substep_count;
+
+		// append the collisions to a buffer read with get_collision_events
+		// instead of calling the collision callbacks of the bodies
+		bool buffer_collision_events;
+
+		// remember the touching pairs of bodies between steps, so that a
+		// contact is reported when it begins and ends, and at every step in
+		// between only if report_persistent_contacts is set. Removing a body
+		// ends its contacts for the bodies it touched, the callbacks run
+		// during remove_body and must queue their changes to the bodies.
+		bool track_contacts;
+		bool report_persistent_contacts;
+
+		// keep the static and sensor bodies out of the broadphase, in an index
+		// built once and queried by every awake dynamic body at each step.
+		// Adding, removing, moving or reshaping one of them builds the index
+		// again before the next step or query.
+		bool separate_static_bodies;
+
+		Settings();
+	};
+
+	// body hit by a ray or shape cast
+	struct Cast_Hit
+	{
+		Body* body;
+		// fraction of the way from start to end at which the body is hit
+		float fraction;
+		// position of the ray or shape when it hits the body
+		Vector2f position;
+		// normal of the surface of the body
+		Vector2f normal;
+	};
+
+	// collision between a dynamic body and another body. The normal points
+	// towards body, the other body sees the opposite normal.
+	struct Collision_Event
+	{
+		Body_Handle body;
+		Body_Handle other_body;
+		Vector2f normal;
+		float distance;
+		Body::Contact_Phase phase;
+	};
+
+	// tests a dynamic body against another body. Returns true and fills
+	// collision if they collide, the corrections of the dynamic body are
+	// accumulated in position_correction and velocity_correction. Against a
+	// dynamic body the engine splits the corrections by inverse mass.
+	typedef bool(*Collision_Function)(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+
+	Physics_Engine(const Vector2f& gravity, const Settings& settings = Settings());
+	~Physics_Engine();
 
 	void update(float delta_time);
 
+	// accumulates elapsed_time and runs as many fixed steps as it covers, up
+	// to max_step_count. Returns the number of steps run.
+	size_t step(float elapsed_time);
+	// fraction of a fixed step left in the accumulator, used to interpolate
+	// between the previous and the current position of the bodies
+	float get_alpha() const;
+
+	// the engine owns the bodies it creates and deletes them when they are
+	// destroyed or when the engine is deleted. Destroying a body through a
+	// stale handle does nothing and returns false. These and the methods
+	// changing bodies below must be called by the thread running update, and
+	// not during it.
+	Body_Handle create_body(Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity);
+	bool destroy_body(Body_Handle handle);
+	// nullptr if the body of the handle has been removed
+	Body* get_body(Body_Handle handle) const;
+
+	// the commands below are safe to queue from any thread at any time, also
+	// from a collision callback. They run in order for each body at the
+	// beginning of the next update, or when apply_commands is called. The
+	// handle of a queued body resolves to nullptr until the body is created.
+	Body_Handle queue_create_body(Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity);
+	void queue_destroy_body(Body_Handle handle);
+	void queue_move_body(Body_Handle handle, const Vector2f& delta_position);
+	void queue_set_velocity(Body_Handle handle, const Vector2f& velocity);
+	void queue_set_shape(Body_Handle handle, Shape* shape);
+	void apply_commands();
+
+	// adds a body allocated by the caller. The engine deletes it when it is
+	// removed, the caller deletes it if it is still there when the engine is.
 	void add_body(Body* body);
+	// adds many bodies at once, much faster than one by one when loading a
+	// level with a binary tree broadphase
+	void add_bodies(Body* const* bodies, size_t count);
 	void remove_body(Body* body);
 	void move_body(Body* body, const Vector2f& delta_position);
+	// replaces the shape of the body, the old shape is deleted
+	void set_shape(Body* body, Shape* shape);
+
+	// a ray from start to end, tested only against the bodies the broadphase
+	// finds along it. Bodies containing start are not hit. The closest hit,
+	// any hit or all hits sorted by fraction are returned.
+	bool raycast(const Vector2f& start, const Vector2f& end, Cast_Hit& hit);
+	bool raycast_any(const Vector2f& start, const Vector2f& end, Cast_Hit& hit);
+	size_t raycast_all(const Vector2f& start, const Vector2f& end, std::vector<Cast_Hit>& hits);
+
+	// as the raycasts, moving a circle or a capsule placed at start
+	bool shape_cast(const Shape* shape, const Vector2f& start, const Vector2f& end, Cast_Hit& hit);
+	bool shape_cast_any(const Shape* shape, const Vector2f& start, const Vector2f& end, Cast_Hit& hit);
+	size_t shape_cast_all(const Shape* shape, const Vector2f& start, const Vector2f& end, std::vector<Cast_Hit>& hits);
+
+	// collisions buffered since the last call to clear_collision_events, in
+	// the order the callbacks would have run
+	const std::vector<Collision_Event>& get_collision_events() const;
+	void clear_collision_events();
+
+	// casts count rays, ray i going from origins[i] along directions[i] for
+	// lengths[i], against the bodies with a category in layer_mask. hits[i]
+	// receives the closest hit of ray i, with a null body if it hits nothing.
+	// Rays close to each other share their broadphase queries, and they are
+	// split across the worker threads if there are any. Returns the number of
+	// rays that hit something.
+	size_t raycast_batch(const Vector2f* origins, const Vector2f* directions, const float* lengths, size_t count, uint32_t layer_mask, Cast_Hit* hits);
+
+	// appends the bodies whose extents overlap the box
+	void overlap_aabb(const Vector2f& min, const Vector2f& max, std::vector<Body*>& bodies);
+
+	// replaces the function used for the given pair of shape types, nullptr
+	// disables the collisions between them
+	void register_collision_function(Shape::Type dynamic_shape_type, Shape::Type other_shape_type, Collision_Function collision_function);
 
 private:
+	// test of a dynamic body against another body and its result
+	struct Contact
+	{
+		Body* dynamic_body;
+		Body* other_body;
+
+		Collision_Function collision_function;
+		// index of the pair of shape types
+		size_t function_index;
+
+		Vector2f position_correction;
+		Vector2f velocity_correction;
+		bool has_collided;
+		Body::Collision collision;
+	};
+
+	enum Command_Type
+	{
+		CREATE_BODY,
+		MOVE_BODY,
+		SET_VELOCITY,
+		SET_SHAPE,
+		DESTROY_BODY
+	};
+
+	// change of a body queued by a queue_ method
+	struct Command
+	{
+		Command_Type type;
+		Body_Handle handle;
+
+		// position of CREATE_BODY, delta position of MOVE_BODY, velocity of
+		// SET_VELOCITY
+		Vector2f vector;
+		// shape of CREATE_BODY and SET_SHAPE
+		Shape* shape;
+
+		Body::Type body_type;
+		std::function<void(Body::Collision& collision)> collision_callback;
+		void* entity;
+	};
+
+	enum Cast_Mode
+	{
+		CLOSEST,
+		ANY,
+		ALL
+	};
+
+	// runs the collision function of a batch of contacts of the same shape types
+	typedef void(*Batch_Collision_Function)(Contact* contacts, const uint32_t* contact_indices, size_t count);
+
+	static const size_t function_count = Shape::Type::TYPE_COUNT * Shape::Type::TYPE_COUNT;
+
 	Vector2f gravity_;
 
-	BinaryTree binary_tree_;
+	Settings settings_;
+
+	float accumulator_;
+
+	Broadphase* broadphase_;
+
+	Collision_Function collision_functions_[Shape::Type::TYPE_COUNT][Shape::Type::TYPE_COUNT];
+	Batch_Collision_Function batch_collision_functions_[function_count];
+
+	Thread_Pool* thread_pool_;
+	// contacts to test in pair order, body_a first
+	std::vector<Contact> contacts_;
+	// indices of the contacts grouped by collision function
+	std::vector<uint32_t> contact_order_;
+	// end of the batch of each function in contact_order_
+	size_t batch_ends_[function_count];
+	// dynamic bodies overlapping the extents of a sensor, they are only
+	// tested for overlap after the other contacts are solved
+	std::vector<std::pair<Body*, Body*>> sensor_contacts_;
+
+	uint32_t next_body_id_;
+
+	// slot of a body referred to by handles
+	struct Body_Slot
+	{
+		Body* body;
+		uint32_t generation;
+		uint32_t next_free_slot;
+		// the body was made by create_body in the block storage
+		bool is_owned;
+	};
+
+	// bodies made by create_body are constructed in blocks of slots which
+	// never move, the body of slot i lives at entry i % body_block_size of
+	// block i / body_block_size
+	static const size_t body_block_size = 256;
+
+	std::vector<Body_Slot> body_slots_;
+	uint32_t first_free_slot_;
+	// slots past the end of body_slots_ handed out to queued bodies
+	uint32_t reserved_slot_count_;
+	std::vector<Body*> body_blocks_;
+
+	// guards the commands and the list of free slots
+	std::mutex command_mutex_;
+	std::vector<Command> commands_;
+	// commands being applied, swapped with commands_ so that new commands can
+	// be queued while they run
+	std::vector<Command> applied_commands_;
+	std::vector<Body*> created_bodies_;
+
+	Body_Arrays body_arrays_;
+
+	Static_Index static_index_;
+	bool is_static_index_dirty_;
+	// pairs of the awake dynamic bodies with the bodies of the index
+	std::vector<Pair_Cache::Pair> static_pairs_;
+	// pairs of the broadphase followed by the static pairs
+	std::vector<Pair_Cache::Pair> step_pairs_;
+	// the dynamic bodies of a batch, without the ones of the index
+	std::vector<Body*> broadphase_bodies_;
+
+	std::vector<Body*> dynamic_bodies_;
+	std::vector<Body*> static_bodies_;
+
+	std::vector<Body*> bodies_to_wake_up_;
+
+	// continuous bodies swept in the current step
+	std::vector<Body*> continuous_bodies_;
+
+	// bodies moved in substeps in the current step and the static bodies
+	// they are paired with
+	std::vector<Body*> substepped_bodies_;
+	std::vector<std::pair<Body*, Body*>> substep_contacts_;
+
+	std::vector<Collision_Event> collision_events_;
+
+	// contact between two bodies, as last reported
+	struct Tracked_Contact
+	{
+		Body* body;
+		Body::Collision collision;
+		// last update in which the bodies touched
+		uint32_t update_index;
+
+		// the bodies of the pair, and where the key of the contact is in the
+		// contact keys of each of them
+		Body* pair_bodies[2];
+		size_t key_indices[2];
+	};
+
+	// touching pairs of bodies, keyed by the ids of the bodies
+	std::unordered_map<uint64_t, Tracked_Contact> tracked_contacts_;
+	uint32_t update_index_;
+	// contacts ended in the current step or by a removed body, reported once
+	// the set is updated
+	std::vector<Tracked_Contact> ended_contacts_;
+
+	// bodies found by the broadphase for a query
+	std::vector<Body*> query_bodies_;
+
+	// rays of a batch sorted by the left side of their box, and the end of
+	// each group of rays sharing a broadphase query
+	std::vector<uint32_t> ray_order_;
+	std::vector<size_t> ray_group_ends_;
+
+	void group_contacts(const std::vector<Pair_Cache::Pair>& pairs);
+	void add_contact(Body* dynamic_body, Body* other_body, size_t* batch_sizes);
+	void apply_contact(const Contact& contact);
+	void detect_sensor_overlaps();
+	void report_collision(Body* body, const Body::Collision& collision);
+	// skipped_body does not get its callback run
+	void dispatch_collision(Body* body, const Body::Collision& collision, const Body* skipped_body = nullptr);
+	void end_contacts();
+	void forget_contacts(Body* body);
+	void link_contact(uint64_t key, Tracked_Contact& contact);
+	void unlink_contact(const Tracked_Contact& contact);
+	void find_bodies_to_wake_up(const Pair_Cache::Pair& pair);
+
+	void begin_substeps(Body* body, float delta_time);
+	void run_substeps(float delta_time);
+	Vector2f get_substep_move(Body* body, float delta_time) const;
+	static float get_substep_size(const Shape* shape);
+
+	// extents of the body at its position
+	static void update_extents(Body* body);
+	static void expand_to_sweep(Body* body);
+	void begin_sweep(Body* body);
+	void solve_impacts();
+	static void find_impact(Body* dynamic_body, Body* other_body);
+
+	bool cast(const Vector2f& start, const Vector2f& end, float radius, float height, Cast_Mode mode, Cast_Hit& hit, std::vector<Cast_Hit>* hits);
+	static bool get_cast_size(const Shape* shape, float& radius, float& height);
+	static bool cast_against(const Vector2f& start, const Vector2f& delta_position, float radius, float height, Body* body, float& time, Vector2f& normal);
+
+	uint32_t allocate_body_slot();
+	uint32_t reserve_body_slot();
+	void release_body_slot(uint32_t slot);
+	Body* construct_body(uint32_t slot, Body::Type type, const Vector2f& position, Shape* shape, std::function<void(Body::Collision& collision)> collision_callback, void* entity);
+	// registers the body in the slot, the caller adds it to the broadphase
+	void insert_body(Body* body, uint32_t slot);
+	void queue_command(const Command& command);
+
+	bool is_in_static_index(const Body* body) const;
+	void add_to_broadphase(Body* body);
+	void add_to_broadphase(Body* const* bodies, size_t count);
+	void remove_from_broadphase(Body* body);
+	void update_static_index();
+	void find_static_pairs();
+	const std::vector<Pair_Cache::Pair>& collect_pairs();
 
-	std::vector<BinaryTree::Ball*> dynamic_body_balls_;
-	std::vector<BinaryTree::Ball*> static_body_balls_;
+	void update_sleep(Body* body, float delta_time);
+	void wake_up_paired_bodies(Body* body);
 
 	static bool fast_detect_collision(Body* dynamic_body, Body* collider_body);
-	static void detect_and_solve_collision(Body* dynamic_body, std::vector<Body*>& other_bodies, float delta_time);
-	static void detect_and_solve_circle_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
-	static void detect_and_solve_circle_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
-	static void detect_and_solve_circle_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
-	static void detect_and_solve_capsule_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
-	static void detect_and_solve_capsule_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
-	static void detect_and_solve_capsule_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction);
+	static void detect_and_solve_circle_box_collisions(Contact* contacts, const uint32_t* contact_indices, size_t count);
+	static void detect_and_solve_circle_circle_collisions(Contact* contacts, const uint32_t* contact_indices, size_t count);
+	static bool detect_and_solve_circle_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+	static bool detect_and_solve_circle_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+	static bool detect_and_solve_circle_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+	static bool detect_and_solve_capsule_box_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+	static bool detect_and_solve_capsule_circle_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
+	static bool detect_and_solve_capsule_chain_collision(Body* dynamic_body, Body* other_body, Vector2f& position_correction, Vector2f& velocity_correction, Body::Collision& collision);
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+const uint32_t null_index = 0xFFFFFFFF;
+
+// stores its items contiguously and recycles the released slots, so the index
+// of an item stays valid until the item is released.
+template<typename T>
+class Pool
+{
+public:
+	uint32_t allocate();
+	void release(uint32_t index);
+	void reserve(size_t capacity);
+
+	T& operator[](uint32_t index);
+	const T& operator[](uint32_t index) const;
+
+private:
+	std::vector<T> items_;
+	std::vector<uint32_t> free_indices_;
+};
+
+template<typename T>
+inline uint32_t Pool<T>::allocate()
+{
+	if (free_indices_.empty())
+	{
+		items_.push_back(T());
+		return static_cast<uint32_t>(items_.size() - 1);
+	}
+
+	uint32_t index = free_indices_.back();
+	free_indices_.pop_back();
+
+	items_[index] = T();
+	return index;
+}
+
+template<typename T>
+inline void Pool<T>::release(uint32_t index)
+{
+	free_indices_.push_back(index);
+}
+
+template<typename T>
+inline void Pool<T>::reserve(size_t capacity)
+{
+	items_.reserve(capacity);
+}
+
+template<typename T>
+inline T& Pool<T>::operator[](uint32_t index)
+{
+	return items_[index];
+}
+
+template<typename T>
+inline const T& Pool<T>::operator[](uint32_t index) const
+{
+	return items_[index];
+}
@@ -1,9 +1,11 @@
 #include "shape.h"
 
-Shape::Shape(Type type, float min_x, float max_x) :
+Shape::Shape(Type type, float min_x, float max_x, float min_y, float max_y) :
 	type_(type),
 	min_x_(min_x),
-	max_x_(max_x)
+	max_x_(max_x),
+	min_y_(min_y),
+	max_y_(max_y)
 {
 }
 
@@ -21,3 +23,18 @@ float Shape::get_max_x() const
 {
 	return max_x_;
 }
+
+float Shape::get_min_y() const
+{
+	return min_y_;
+}
+
+float Shape::get_max_y() const
+{
+	return max_y_;
+}
+
+void Shape::set_max_y(float max_y)
+{
+	max_y_ = max_y;
+}
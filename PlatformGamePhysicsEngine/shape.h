@@ -9,18 +9,25 @@ class Shape
 public:
 	enum Type;
 
-	Shape(Type type, float min_x, float max_x);
+	Shape(Type type, float min_x, float max_x, float min_y, float max_y);
 	virtual ~Shape() {}
 
 	Type get_type() const;
 	float get_min_x() const;
 	float get_max_x() const;
+	float get_min_y() const;
+	float get_max_y() const;
+
+protected:
+	void set_max_y(float max_y);
 
 private:
 	Type type_;
 
 	float min_x_;
 	float max_x_;
+	float min_y_;
+	float max_y_;
 };
 
 enum Shape::Type
@@ -28,5 +35,8 @@ enum Shape::Type
 	BOX,
 	CIRCLE,
 	CAPSULE,
-	CHAIN
+	CHAIN,
+
+	// number of shape types, keep it last
+	TYPE_COUNT
 };
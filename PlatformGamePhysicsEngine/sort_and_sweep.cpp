@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <limits>
+#include "sort_and_sweep.h"
+
+Sort_And_Sweep::Sort_And_Sweep() :
+	max_width_(0.0f)
+{
+}
+
+void Sort_And_Sweep::add_body(Body* body)
+{
+	Proxy proxy;
+	proxy.body = body;
+	proxy.max_endpoint = endpoints_.size();
+	proxy.min_endpoint = endpoints_.size() + 1;
+
+	body->proxy_ = proxies_.size();
+	proxies_.push_back(proxy);
+
+	// append the endpoints and sort them in place, the max first so that the
+	// min finds all the overlapping intervals while moving down
+	Endpoint max_endpoint = { body->max_x(), body->proxy_, true };
+	Endpoint min_endpoint = { body->min_x(), body->proxy_, false };
+	endpoints_.push_back(max_endpoint);
+	endpoints_.push_back(min_endpoint);
+
+	sort_down(proxies_[body->proxy_].max_endpoint);
+	sort_down(proxies_[body->proxy_].min_endpoint);
+
+	max_width_ = std::max(max_width_, body->max_x() - body->min_x());
+}
+
+void Sort_And_Sweep::remove_body(Body* body)
+{
+	size_t proxy = body->proxy_;
+
+	// move the endpoints to the end, the min first so that every pair of the
+	// body is removed while it moves up and none is added back by the max
+	const float infinity = std::numeric_limits<float>::infinity();
+
+	endpoints_[proxies_[proxy].min_endpoint].value = infinity;
+	sort_up(proxies_[proxy].min_endpoint);
+	endpoints_[proxies_[proxy].max_endpoint].value = infinity;
+	sort_up(proxies_[proxy].max_endpoint);
+
+	// the last two endpoints belong to the body now
+	endpoints_.pop_back();
+	endpoints_.pop_back();
+
+	// move the last proxy in the freed slot
+	proxies_[proxy] = proxies_.back();
+	proxies_.pop_back();
+
+	if (proxies_.empty())
+	{
+		max_width_ = 0.0f;
+	}
+
+	if (proxy < proxies_.size())
+	{
+		proxies_[proxy].body->proxy_ = proxy;
+		endpoints_[proxies_[proxy].min_endpoint].proxy = proxy;
+		endpoints_[proxies_[proxy].max_endpoint].proxy = proxy;
+	}
+}
+
+void Sort_And_Sweep::update_body(Body* body)
+{
+	const Proxy& proxy = proxies_[body->proxy_];
+
+	endpoints_[proxy.min_endpoint].value = body->min_x();
+	endpoints_[proxy.max_endpoint].value = body->max_x();
+
+	max_width_ = std::max(max_width_, body->max_x() - body->min_x());
+
+	// only one direction moves each endpoint, the other returns immediately
+	sort_down(proxy.min_endpoint);
+	sort_down(proxy.max_endpoint);
+	sort_up(proxy.max_endpoint);
+	sort_up(proxy.min_endpoint);
+}
+
+void Sort_And_Sweep::query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const
+{
+	// no interval overlapping the range begins before min_x - max_width_
+	auto it = std::lower_bound(endpoints_.begin(), endpoints_.end(), min_x - max_width_,
+		[](const Endpoint& endpoint, float value) { return endpoint.value < value; });
+
+	for (; it != endpoints_.end() && it->value <= max_x; ++it)
+	{
+		if (it->is_max)
+		{
+			continue;
+		}
+
+		Body* body = proxies_[it->proxy].body;
+		if (overlaps(body, min_x, min_y, max_x, max_y))
+		{
+			bodies.push_back(body);
+		}
+	}
+}
+
+void Sort_And_Sweep::sort_down(size_t endpoint)
+{
+	while (endpoint > 0 && endpoints_[endpoint - 1].value > endpoints_[endpoint].value)
+	{
+		const Endpoint& moving = endpoints_[endpoint];
+		const Endpoint& other = endpoints_[endpoint - 1];
+
+		if (moving.proxy != other.proxy)
+		{
+			const Proxy& moving_proxy = proxies_[moving.proxy];
+			const Proxy& other_proxy = proxies_[other.proxy];
+
+			// a min moving below a max: the intervals may start overlapping
+			if (!moving.is_max && other.is_max)
+			{
+				if (overlap(moving_proxy, other_proxy) && can_pair(moving_proxy.body, other_proxy.body))
+				{
+					pair_cache_.add(moving_proxy.body, other_proxy.body);
+				}
+			}
+			// a max moving below a min: the intervals stop overlapping
+			else if (moving.is_max && !other.is_max)
+			{
+				pair_cache_.remove(moving_proxy.body, other_proxy.body);
+			}
+		}
+
+		swap_endpoints(endpoint, endpoint - 1);
+		endpoint--;
+	}
+}
+
+void Sort_And_Sweep::sort_up(size_t endpoint)
+{
+	while (endpoint + 1 < endpoints_.size() && endpoints_[endpoint + 1].value < endpoints_[endpoint].value)
+	{
+		const Endpoint& moving = endpoints_[endpoint];
+		const Endpoint& other = endpoints_[endpoint + 1];
+
+		if (moving.proxy != other.proxy)
+		{
+			const Proxy& moving_proxy = proxies_[moving.proxy];
+			const Proxy& other_proxy = proxies_[other.proxy];
+
+			// a max moving above a min: the intervals may start overlapping
+			if (moving.is_max && !other.is_max)
+			{
+				if (overlap(moving_proxy, other_proxy) && can_pair(moving_proxy.body, other_proxy.body))
+				{
+					pair_cache_.add(moving_proxy.body, other_proxy.body);
+				}
+			}
+			// a min moving above a max: the intervals stop overlapping
+			else if (!moving.is_max && other.is_max)
+			{
+				pair_cache_.remove(moving_proxy.body, other_proxy.body);
+			}
+		}
+
+		swap_endpoints(endpoint, endpoint + 1);
+		endpoint++;
+	}
+}
+
+void Sort_And_Sweep::swap_endpoints(size_t endpoint_a, size_t endpoint_b)
+{
+	std::swap(endpoints_[endpoint_a], endpoints_[endpoint_b]);
+
+	const Endpoint& a = endpoints_[endpoint_a];
+	const Endpoint& b = endpoints_[endpoint_b];
+
+	if (a.is_max)
+	{
+		proxies_[a.proxy].max_endpoint = endpoint_a;
+	}
+	else
+	{
+		proxies_[a.proxy].min_endpoint = endpoint_a;
+	}
+
+	if (b.is_max)
+	{
+		proxies_[b.proxy].max_endpoint = endpoint_b;
+	}
+	else
+	{
+		proxies_[b.proxy].min_endpoint = endpoint_b;
+	}
+}
+
+bool Sort_And_Sweep::overlap(const Proxy& proxy_a, const Proxy& proxy_b) const
+{
+	return endpoints_[proxy_a.min_endpoint].value < endpoints_[proxy_b.max_endpoint].value
+		&& endpoints_[proxy_a.max_endpoint].value > endpoints_[proxy_b.min_endpoint].value;
+}
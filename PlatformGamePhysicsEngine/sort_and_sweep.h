@@ -0,0 +1,45 @@
+#pragma once
+
+#include "broadphase.h"
+
+// keeps the endpoints of the x-intervals of the bodies sorted with an
+// insertion sort, which is close to linear when bodies move little between two
+// steps. Every time two endpoints swap, the pair of their bodies is added to or
+// removed from the pair cache.
+class Sort_And_Sweep :public Broadphase
+{
+public:
+	Sort_And_Sweep();
+
+	void add_body(Body* body) override;
+	void remove_body(Body* body) override;
+	void update_body(Body* body) override;
+	void query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const override;
+
+private:
+	struct Endpoint
+	{
+		float value;
+		size_t proxy;
+		bool is_max;
+	};
+
+	struct Proxy
+	{
+		Body* body;
+		size_t min_endpoint;
+		size_t max_endpoint;
+	};
+
+	std::vector<Endpoint> endpoints_;
+	std::vector<Proxy> proxies_;
+
+	// widest interval seen since the broadphase was last empty, bounds the
+	// search of the intervals overlapping a range
+	float max_width_;
+
+	void sort_down(size_t endpoint);
+	void sort_up(size_t endpoint);
+	void swap_endpoints(size_t endpoint_a, size_t endpoint_b);
+	bool overlap(const Proxy& proxy_a, const Proxy& proxy_b) const;
+};
@@ -0,0 +1,170 @@
+#include <algorithm>
+#include "static_index.h"
+
+Static_Index::Static_Index() :
+	min_x_(0.0f),
+	min_y_(0.0f),
+	cell_size_(1.0f),
+	column_count_(0),
+	row_count_(0)
+{
+}
+
+void Static_Index::build(const std::vector<Body*>& bodies)
+{
+	clear();
+
+	if (bodies.empty())
+	{
+		return;
+	}
+
+	// a cell as large as the typical body
+	std::vector<float> sizes;
+	sizes.reserve(bodies.size());
+
+	min_x_ = bodies[0]->min_x();
+	min_y_ = bodies[0]->min_y();
+	float max_x = bodies[0]->max_x();
+	float max_y = bodies[0]->max_y();
+	for each (auto body in bodies)
+	{
+		sizes.push_back(std::max(body->max_x() - body->min_x(), body->max_y() - body->min_y()));
+
+		min_x_ = std::min(min_x_, body->min_x());
+		min_y_ = std::min(min_y_, body->min_y());
+		max_x = std::max(max_x, body->max_x());
+		max_y = std::max(max_y, body->max_y());
+	}
+
+	std::nth_element(sizes.begin(), sizes.begin() + sizes.size() / 2, sizes.end());
+	cell_size_ = sizes[sizes.size() / 2];
+	if (cell_size_ <= 0.0f)
+	{
+		cell_size_ = 1.0f;
+	}
+
+	// sparse levels would waste most cells, keep about as many cells as bodies
+	while (true)
+	{
+		column_count_ = get_column(max_x) + 1;
+		row_count_ = get_row(max_y) + 1;
+		if (column_count_ * row_count_ <= 4 * bodies.size())
+		{
+			break;
+		}
+
+		cell_size_ *= 2.0f;
+	}
+
+	// count the entries of each cell, then place them
+	size_t cell_count = column_count_ * row_count_;
+	cell_begins_.assign(cell_count + 1, 0);
+	for each (auto body in bodies)
+	{
+		for (size_t row = get_row(body->min_y()); row <= get_row(body->max_y()); row++)
+		{
+			for (size_t column = get_column(body->min_x()); column <= get_column(body->max_x()); column++)
+			{
+				cell_begins_[row * column_count_ + column + 1]++;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < cell_count; i++)
+	{
+		cell_begins_[i + 1] += cell_begins_[i];
+	}
+
+	entries_.resize(cell_begins_[cell_count]);
+
+	std::vector<size_t> cell_ends(cell_begins_.begin(), cell_begins_.end() - 1);
+	for each (auto body in bodies)
+	{
+		Entry entry;
+		entry.min_x = body->min_x();
+		entry.max_x = body->max_x();
+		entry.min_y = body->min_y();
+		entry.max_y = body->max_y();
+		entry.body = body;
+
+		for (size_t row = get_row(entry.min_y); row <= get_row(entry.max_y); row++)
+		{
+			for (size_t column = get_column(entry.min_x); column <= get_column(entry.max_x); column++)
+			{
+				entries_[cell_ends[row * column_count_ + column]++] = entry;
+			}
+		}
+	}
+}
+
+void Static_Index::clear()
+{
+	column_count_ = 0;
+	row_count_ = 0;
+	cell_begins_.clear();
+	entries_.clear();
+}
+
+void Static_Index::query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const
+{
+	if (entries_.empty())
+	{
+		return;
+	}
+
+	size_t first_column = get_column(min_x);
+	size_t first_row = get_row(min_y);
+	if (max_x < min_x_ || max_y < min_y_ || first_column >= column_count_ || first_row >= row_count_)
+	{
+		return;
+	}
+
+	size_t last_column = std::min(get_column(max_x), column_count_ - 1);
+	size_t last_row = std::min(get_row(max_y), row_count_ - 1);
+
+	for (size_t row = first_row; row <= last_row; row++)
+	{
+		for (size_t column = first_column; column <= last_column; column++)
+		{
+			size_t cell = row * column_count_ + column;
+			for (size_t i = cell_begins_[cell]; i < cell_begins_[cell + 1]; i++)
+			{
+				const Entry& entry = entries_[i];
+				if (entry.min_x > max_x || entry.max_x < min_x || entry.min_y > max_y || entry.max_y < min_y)
+				{
+					continue;
+				}
+
+				// a body spanning several cells is reported by the first cell
+				// it shares with the range
+				if (column != std::max(get_column(entry.min_x), first_column) || row != std::max(get_row(entry.min_y), first_row))
+				{
+					continue;
+				}
+
+				bodies.push_back(entry.body);
+			}
+		}
+	}
+}
+
+size_t Static_Index::get_column(float x) const
+{
+	if (x <= min_x_)
+	{
+		return 0;
+	}
+
+	return static_cast<size_t>((x - min_x_) / cell_size_);
+}
+
+size_t Static_Index::get_row(float y) const
+{
+	if (y <= min_y_)
+	{
+		return 0;
+	}
+
+	return static_cast<size_t>((y - min_y_) / cell_size_);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <vector>
+#include "body.h"
+
+// static and sensor bodies baked into a grid of square cells. The grid is
+// built once and never updated: it keeps nothing per neighbour, the dynamic
+// bodies find the bodies around them with a range query at every step. The
+// entries of a cell are packed together, a body spanning several cells is
+// copied in each of them.
+class Static_Index
+{
+public:
+	Static_Index();
+
+	// replaces the content of the index with the bodies
+	void build(const std::vector<Body*>& bodies);
+	void clear();
+
+	// appends the bodies whose extents overlap the box, each of them once
+	void query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const;
+
+private:
+	struct Entry
+	{
+		float min_x;
+		float max_x;
+		float min_y;
+		float max_y;
+		Body* body;
+	};
+
+	float min_x_;
+	float min_y_;
+	float cell_size_;
+	size_t column_count_;
+	size_t row_count_;
+
+	// the entries of cell i are in [cell_begins_[i], cell_begins_[i + 1]),
+	// cells are stored row by row
+	std::vector<size_t> cell_begins_;
+	std::vector<Entry> entries_;
+
+	size_t get_column(float x) const;
+	size_t get_row(float y) const;
+};
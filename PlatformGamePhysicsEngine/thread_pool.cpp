@@ -0,0 +1,106 @@
+#include "thread_pool.h"
+
+Thread_Pool::Thread_Pool(size_t worker_thread_count) :
+	function_(nullptr),
+	count_(0),
+	grain_size_(1),
+	next_index_(0),
+	generation_(0),
+	busy_count_(0),
+	should_stop_(false)
+{
+	for (size_t i = 0; i < worker_thread_count; i++)
+	{
+		threads_.push_back(std::thread(&Thread_Pool::run_worker, this));
+	}
+}
+
+Thread_Pool::~Thread_Pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		should_stop_ = true;
+	}
+	work_condition_.notify_all();
+
+	for (size_t i = 0; i < threads_.size(); i++)
+	{
+		threads_[i].join();
+	}
+}
+
+void Thread_Pool::parallel_for(size_t count, size_t grain_size, const std::function<void(size_t begin, size_t end)>& function)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// not worth waking up the workers
+	if (threads_.empty() || count <= grain_size)
+	{
+		function(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		function_ = &function;
+		count_ = count;
+		grain_size_ = grain_size > 0 ? grain_size : 1;
+		next_index_ = 0;
+		busy_count_ = threads_.size();
+		generation_++;
+	}
+	work_condition_.notify_all();
+
+	run_ranges();
+
+	// every worker must be done before function goes out of scope
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_condition_.wait(lock, [this]() { return busy_count_ == 0; });
+	function_ = nullptr;
+}
+
+void Thread_Pool::run_worker()
+{
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			work_condition_.wait(lock, [this, generation]() { return should_stop_ || generation_ != generation; });
+
+			if (should_stop_)
+			{
+				return;
+			}
+
+			generation = generation_;
+		}
+
+		run_ranges();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			busy_count_--;
+		}
+		done_condition_.notify_one();
+	}
+}
+
+void Thread_Pool::run_ranges()
+{
+	while (true)
+	{
+		size_t begin = next_index_.fetch_add(grain_size_);
+		if (begin >= count_)
+		{
+			return;
+		}
+
+		size_t end = begin + grain_size_ < count_ ? begin + grain_size_ : count_;
+		(*function_)(begin, end);
+	}
+}
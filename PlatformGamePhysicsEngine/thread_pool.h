@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads running data-parallel loops. The calling thread
+// works on the loop too and returns when the whole loop has run.
+class Thread_Pool
+{
+public:
+	Thread_Pool(size_t worker_thread_count);
+	~Thread_Pool();
+
+	// calls function(begin, end) on ranges of at most grain_size indices
+	// covering [0, count)
+	void parallel_for(size_t count, size_t grain_size, const std::function<void(size_t begin, size_t end)>& function);
+
+private:
+	std::vector<std::thread> threads_;
+
+	std::mutex mutex_;
+	std::condition_variable work_condition_;
+	std::condition_variable done_condition_;
+
+	// the current loop
+	const std::function<void(size_t begin, size_t end)>* function_;
+	size_t count_;
+	size_t grain_size_;
+	std::atomic<size_t> next_index_;
+
+	// incremented for every loop, so that a worker runs each loop once
+	uint64_t generation_;
+	// number of workers still running the current loop
+	size_t busy_count_;
+	bool should_stop_;
+
+	void run_worker();
+	void run_ranges();
+};
@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include "uniform_grid.h"
+
+Uniform_Grid::Uniform_Grid(float cell_size) :
+	cell_size_(cell_size),
+	inverse_cell_size_(1.0f / cell_size)
+{
+	if (cell_size <= 0.0f)
+	{
+		throw std::runtime_error("the cell size is negative!");
+	}
+}
+
+void Uniform_Grid::add_body(Body* body)
+{
+	Proxy proxy;
+	proxy.body = body;
+	proxy.cells = compute_cell_range(body);
+
+	body->proxy_ = proxies_.size();
+	proxies_.push_back(proxy);
+
+	for (int y = proxy.cells.min_y; y <= proxy.cells.max_y; y++)
+	{
+		for (int x = proxy.cells.min_x; x <= proxy.cells.max_x; x++)
+		{
+			insert(body->proxy_, x, y);
+		}
+	}
+}
+
+void Uniform_Grid::remove_body(Body* body)
+{
+	size_t proxy = body->proxy_;
+
+	Cell_Range cells = proxies_[proxy].cells;
+	for (int y = cells.min_y; y <= cells.max_y; y++)
+	{
+		for (int x = cells.min_x; x <= cells.max_x; x++)
+		{
+			erase(proxy, x, y, nullptr);
+		}
+	}
+
+	// move the last proxy in the freed slot
+	size_t last = proxies_.size() - 1;
+	if (proxy != last)
+	{
+		proxies_[proxy] = proxies_[last];
+		proxies_[proxy].body->proxy_ = proxy;
+
+		const Cell_Range& moved_cells = proxies_[proxy].cells;
+		for (int y = moved_cells.min_y; y <= moved_cells.max_y; y++)
+		{
+			for (int x = moved_cells.min_x; x <= moved_cells.max_x; x++)
+			{
+				std::vector<size_t>& cell = cells_[compute_key(x, y)];
+				for (size_t i = 0; i < cell.size(); i++)
+				{
+					if (cell[i] == last)
+					{
+						cell[i] = proxy;
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	proxies_.pop_back();
+}
+
+void Uniform_Grid::update_body(Body* body)
+{
+	size_t proxy = body->proxy_;
+
+	// a body with invalid extents keeps its cells
+	if (!(body->min_x() <= body->max_x() && body->min_y() <= body->max_y()))
+	{
+		return;
+	}
+
+	Cell_Range old_cells = proxies_[proxy].cells;
+	Cell_Range new_cells = compute_cell_range(body);
+
+	if (old_cells.min_x == new_cells.min_x && old_cells.max_x == new_cells.max_x
+		&& old_cells.min_y == new_cells.min_y && old_cells.max_y == new_cells.max_y)
+	{
+		return;
+	}
+
+	proxies_[proxy].cells = new_cells;
+
+	// leave the cells outside the new range
+	for (int y = old_cells.min_y; y <= old_cells.max_y; y++)
+	{
+		for (int x = old_cells.min_x; x <= old_cells.max_x; x++)
+		{
+			if (!new_cells.contains(x, y))
+			{
+				erase(proxy, x, y, &new_cells);
+			}
+		}
+	}
+
+	// enter the cells outside the old range
+	for (int y = new_cells.min_y; y <= new_cells.max_y; y++)
+	{
+		for (int x = new_cells.min_x; x <= new_cells.max_x; x++)
+		{
+			if (!old_cells.contains(x, y))
+			{
+				insert(proxy, x, y);
+			}
+		}
+	}
+}
+
+void Uniform_Grid::query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const
+{
+	Cell_Range cells;
+	cells.min_x = static_cast<int>(floorf(min_x * inverse_cell_size_));
+	cells.min_y = static_cast<int>(floorf(min_y * inverse_cell_size_));
+	cells.max_x = static_cast<int>(floorf(max_x * inverse_cell_size_));
+	cells.max_y = static_cast<int>(floorf(max_y * inverse_cell_size_));
+
+	// a box covering more cells than there are bodies is cheaper to test
+	// against every body
+	double cell_count = (static_cast<double>(cells.max_x) - cells.min_x + 1.0) * (static_cast<double>(cells.max_y) - cells.min_y + 1.0);
+	if (cell_count > static_cast<double>(proxies_.size()))
+	{
+		for each (auto proxy in proxies_)
+		{
+			if (overlaps(proxy.body, min_x, min_y, max_x, max_y))
+			{
+				bodies.push_back(proxy.body);
+			}
+		}
+
+		return;
+	}
+
+	for (int y = cells.min_y; y <= cells.max_y; y++)
+	{
+		for (int x = cells.min_x; x <= cells.max_x; x++)
+		{
+			auto it = cells_.find(compute_key(x, y));
+			if (it == cells_.end())
+			{
+				continue;
+			}
+
+			for each (auto cell_proxy in it->second)
+			{
+				const Proxy& proxy = proxies_[cell_proxy];
+
+				// a body in several cells is reported by the first cell of the
+				// box it is in
+				if (x != std::max(proxy.cells.min_x, cells.min_x) || y != std::max(proxy.cells.min_y, cells.min_y))
+				{
+					continue;
+				}
+
+				if (overlaps(proxy.body, min_x, min_y, max_x, max_y))
+				{
+					bodies.push_back(proxy.body);
+				}
+			}
+		}
+	}
+}
+
+Uniform_Grid::Cell_Range Uniform_Grid::compute_cell_range(Body* body) const
+{
+	Cell_Range cells;
+	cells.min_x = static_cast<int>(floorf(body->min_x() * inverse_cell_size_));
+	cells.min_y = static_cast<int>(floorf(body->min_y() * inverse_cell_size_));
+	cells.max_x = static_cast<int>(floorf(body->max_x() * inverse_cell_size_));
+	cells.max_y = static_cast<int>(floorf(body->max_y() * inverse_cell_size_));
+
+	return cells;
+}
+
+uint64_t Uniform_Grid::compute_key(int x, int y)
+{
+	return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+void Uniform_Grid::insert(size_t proxy, int x, int y)
+{
+	std::vector<size_t>& cell = cells_[compute_key(x, y)];
+
+	Body* body = proxies_[proxy].body;
+	for each (auto cell_proxy in cell)
+	{
+		Body* cell_body = proxies_[cell_proxy].body;
+		if (can_pair(body, cell_body))
+		{
+			pair_cache_.add(body, cell_body);
+		}
+	}
+
+	cell.push_back(proxy);
+}
+
+void Uniform_Grid::erase(size_t proxy, int x, int y, const Cell_Range* new_cells)
+{
+	auto it = cells_.find(compute_key(x, y));
+	if (it == cells_.end())
+	{
+		return;
+	}
+
+	std::vector<size_t>& cell = it->second;
+
+	Body* body = proxies_[proxy].body;
+	size_t i = 0;
+	while (i < cell.size())
+	{
+		if (cell[i] == proxy)
+		{
+			cell[i] = cell.back();
+			cell.pop_back();
+			continue;
+		}
+
+		// the bodies stay paired while they share another cell
+		if (new_cells == nullptr || !new_cells->intersects(proxies_[cell[i]].cells))
+		{
+			pair_cache_.remove(body, proxies_[cell[i]].body);
+		}
+
+		i++;
+	}
+
+	// empty cells are kept, bodies often come back to the cells they left
+}
+
+bool Uniform_Grid::Cell_Range::contains(int x, int y) const
+{
+	return x >= min_x && x <= max_x && y >= min_y && y <= max_y;
+}
+
+bool Uniform_Grid::Cell_Range::intersects(const Cell_Range& other) const
+{
+	return min_x <= other.max_x && max_x >= other.min_x && min_y <= other.max_y && max_y >= other.min_y;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <unordered_map>
+#include "broadphase.h"
+
+// hashes the bodies in the square cells of an unbounded grid, culling on both
+// axes. Two bodies are paired while they share at least one cell.
+class Uniform_Grid :public Broadphase
+{
+public:
+	Uniform_Grid(float cell_size);
+
+	void add_body(Body* body) override;
+	void remove_body(Body* body) override;
+	void update_body(Body* body) override;
+	void query(float min_x, float min_y, float max_x, float max_y, std::vector<Body*>& bodies) const override;
+
+private:
+	struct Cell_Range
+	{
+		int min_x;
+		int min_y;
+		int max_x;
+		int max_y;
+
+		bool contains(int x, int y) const;
+		bool intersects(const Cell_Range& other) const;
+	};
+
+	struct Proxy
+	{
+		Body* body;
+		Cell_Range cells;
+	};
+
+	const float cell_size_;
+	const float inverse_cell_size_;
+
+	std::unordered_map<uint64_t, std::vector<size_t>> cells_;
+	std::vector<Proxy> proxies_;
+
+	Cell_Range compute_cell_range(Body* body) const;
+	static uint64_t compute_key(int x, int y);
+
+	void insert(size_t proxy, int x, int y);
+	// new_cells is the range the body is moving to, nullptr if the body is
+	// removed and loses all its pairs
+	void erase(size_t proxy, int x, int y, const Cell_Range* new_cells);
+};
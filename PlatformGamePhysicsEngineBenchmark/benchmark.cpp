@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "scene_generator.h"
+
+struct Benchmark_Settings
+{
+	Scene_Settings scene;
+	Physics_Engine::Settings engine;
+
+	size_t warmup_step_count;
+	size_t step_count;
+	float delta_time;
+	// sweep the dynamic bodies against the static ones
+	bool continuous;
+
+	Benchmark_Settings() :
+		warmup_step_count(100),
+		step_count(1000),
+		delta_time(1.0f / 60.0f),
+		continuous(false)
+	{
+	}
+};
+
+static void print_usage(const char* program)
+{
+	std::cout
+		<< "usage: " << program << " [options]" << std::endl
+		<< "  --circles N       number of dynamic circles" << std::endl
+		<< "  --capsules N      number of dynamic capsules" << std::endl
+		<< "  --boxes N         number of static boxes" << std::endl
+		<< "  --chains N        number of chain terrains" << std::endl
+		<< "  --width W         world width" << std::endl
+		<< "  --height H        height of the platform area" << std::endl
+		<< "  --steps N         number of measured steps" << std::endl
+		<< "  --warmup N        number of steps run before measuring" << std::endl
+		<< "  --dt T            time step in seconds" << std::endl
+		<< "  --seed N          random seed of the scene generator" << std::endl
+		<< "  --body-arrays 0|1 keep dynamic body state in contiguous arrays" << std::endl
+		<< "  --broadphase B    tree, sap or grid" << std::endl
+		<< "  --cell-size S     cell size of the grid broadphase" << std::endl
+		<< "  --sleep 0|1       let bodies at rest fall asleep" << std::endl
+		<< "  --threads N       worker threads of the narrowphase" << std::endl
+		<< "  --continuous 0|1  sweep dynamic bodies against static ones" << std::endl
+		<< "  --substeps N      maximum substeps of a fast dynamic body" << std::endl
+		<< "  --static-index 0|1 keep static bodies in a separate index" << std::endl;
+}
+
+static bool parse_arguments(int argc, char** argv, Benchmark_Settings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 >= argc)
+		{
+			return false;
+		}
+
+		const char* name = argv[i];
+		const char* value = argv[++i];
+
+		if (strcmp(name, "--circles") == 0)
+		{
+			settings.scene.dynamic_circle_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--capsules") == 0)
+		{
+			settings.scene.dynamic_capsule_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--boxes") == 0)
+		{
+			settings.scene.static_box_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--chains") == 0)
+		{
+			settings.scene.chain_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--width") == 0)
+		{
+			settings.scene.world_width = strtof(value, nullptr);
+		}
+		else if (strcmp(name, "--height") == 0)
+		{
+			settings.scene.world_height = strtof(value, nullptr);
+		}
+		else if (strcmp(name, "--steps") == 0)
+		{
+			settings.step_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--warmup") == 0)
+		{
+			settings.warmup_step_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--dt") == 0)
+		{
+			settings.delta_time = strtof(value, nullptr);
+		}
+		else if (strcmp(name, "--seed") == 0)
+		{
+			settings.scene.seed = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--body-arrays") == 0)
+		{
+			settings.engine.use_body_arrays = strtoul(value, nullptr, 10) != 0;
+		}
+		else if (strcmp(name, "--broadphase") == 0)
+		{
+			if (strcmp(value, "tree") == 0)
+			{
+				settings.engine.broadphase_type = Physics_Engine::Broadphase_Type::BINARY_TREE;
+			}
+			else if (strcmp(value, "sap") == 0)
+			{
+				settings.engine.broadphase_type = Physics_Engine::Broadphase_Type::SORT_AND_SWEEP;
+			}
+			else if (strcmp(value, "grid") == 0)
+			{
+				settings.engine.broadphase_type = Physics_Engine::Broadphase_Type::UNIFORM_GRID;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		else if (strcmp(name, "--cell-size") == 0)
+		{
+			settings.engine.grid_cell_size = strtof(value, nullptr);
+		}
+		else if (strcmp(name, "--sleep") == 0)
+		{
+			settings.engine.allow_sleeping = strtoul(value, nullptr, 10) != 0;
+		}
+		else if (strcmp(name, "--threads") == 0)
+		{
+			settings.engine.worker_thread_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--substeps") == 0)
+		{
+			settings.engine.max_substep_count = strtoul(value, nullptr, 10);
+		}
+		else if (strcmp(name, "--static-index") == 0)
+		{
+			settings.engine.separate_static_bodies = strtoul(value, nullptr, 10) != 0;
+		}
+		else if (strcmp(name, "--continuous") == 0)
+		{
+			settings.continuous = strtoul(value, nullptr, 10) != 0;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	return settings.step_count > 0 && settings.delta_time > 0.0f;
+}
+
+static long long percentile(const std::vector<long long>& sorted_samples, double p)
+{
+	size_t index = static_cast<size_t>(p * (sorted_samples.size() - 1) + 0.5);
+	return sorted_samples[index];
+}
+
+int main(int argc, char** argv)
+{
+	Benchmark_Settings settings;
+	if (!parse_arguments(argc, argv, settings))
+	{
+		print_usage(argv[0]);
+		return -1;
+	}
+
+	Physics_Engine* physics_engine(nullptr);
+	std::vector<Body*> bodies;
+	int result = 0;
+
+	try
+	{
+		physics_engine = new Physics_Engine(Vector2f(0.0f, -9.81f), settings.engine);
+
+		generate_scene(*physics_engine, settings.scene, bodies);
+
+		for each (auto body in bodies)
+		{
+			body->set_continuous(settings.continuous);
+		}
+
+		for (size_t i = 0; i < settings.warmup_step_count; i++)
+		{
+			physics_engine->update(settings.delta_time);
+		}
+
+		std::vector<long long> samples(settings.step_count);
+		for (size_t i = 0; i < settings.step_count; i++)
+		{
+			auto start = std::chrono::steady_clock::now();
+
+			physics_engine->update(settings.delta_time);
+
+			auto end = std::chrono::steady_clock::now();
+			samples[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		}
+
+		long long total = 0;
+		for each (auto sample in samples)
+		{
+			total += sample;
+		}
+
+		std::sort(samples.begin(), samples.end());
+
+		size_t dynamic_body_count = settings.scene.dynamic_circle_count + settings.scene.dynamic_capsule_count;
+		double ns_per_step = static_cast<double>(total) / settings.step_count;
+
+		std::cout
+			<< "dynamic circles:  " << settings.scene.dynamic_circle_count << std::endl
+			<< "dynamic capsules: " << settings.scene.dynamic_capsule_count << std::endl
+			<< "static boxes:     " << settings.scene.static_box_count << std::endl
+			<< "chains:           " << settings.scene.chain_count << std::endl
+			<< "world width:      " << settings.scene.world_width << std::endl
+			<< "world height:     " << settings.scene.world_height << std::endl
+			<< "steps:            " << settings.step_count << std::endl
+			<< "ns/step:          " << static_cast<long long>(ns_per_step) << std::endl
+			<< "ns/body:          " << (dynamic_body_count > 0 ? ns_per_step / dynamic_body_count : 0.0) << std::endl
+			<< "p50 step:         " << percentile(samples, 0.50) << " ns" << std::endl
+			<< "p99 step:         " << percentile(samples, 0.99) << " ns" << std::endl;
+	}
+	catch (const std::exception& exception)
+	{
+		std::cerr << "error: " << exception.what() << std::endl;
+		result = -1;
+	}
+
+	delete physics_engine;
+	for each (auto body in bodies)
+	{
+		delete body;
+	}
+
+	return result;
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <random>
+#include "scene_generator.h"
+
+Scene_Settings::Scene_Settings() :
+	dynamic_circle_count(1000),
+	dynamic_capsule_count(100),
+	static_box_count(200),
+	chain_count(10),
+	world_width(2000.0f),
+	world_height(20.0f),
+	seed(1)
+{
+}
+
+static void add_chain(Physics_Engine& physics_engine, float min_x, float max_x, std::mt19937& random, std::vector<Body*>& bodies)
+{
+	std::uniform_real_distribution<float> column_width(2.0f, 10.0f);
+	std::uniform_real_distribution<float> column_height(2.0f, 8.0f);
+
+	// the chain is a sequence of columns: every column adds the vertex on the
+	// top left and the vertex on the top right
+	std::vector<Vector2f> vertices;
+	vertices.push_back(Vector2f(0.0f, 0.0f));
+
+	float x = 0.0f;
+	float width = max_x - min_x;
+	while (x < width)
+	{
+		float height = column_height(random);
+		float next_x = std::min(x + column_width(random), width);
+
+		vertices.push_back(Vector2f(x, height));
+		vertices.push_back(Vector2f(next_x, height));
+
+		x = next_x;
+	}
+
+	vertices.push_back(Vector2f(width, 0.0f));
+
+	Shape* shape = new Chain_Shape(vertices);
+	Body* body = new Body(Body::Type::STATIC, Vector2f(min_x, 0.0f), shape, nullptr, nullptr);
+	body->bouncing_ = 0.0f;
+	body->friction_ = 1.0f;
+	physics_engine.add_body(body);
+	bodies.push_back(body);
+}
+
+void generate_scene(Physics_Engine& physics_engine, const Scene_Settings& settings, std::vector<Body*>& bodies)
+{
+	if (settings.world_width <= 0.0f || settings.world_height <= 0.0f)
+	{
+		throw std::runtime_error("the world width and/or height are negative!");
+	}
+
+	std::mt19937 random(settings.seed);
+	std::uniform_real_distribution<float> world_x(0.0f, settings.world_width);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	// terrain
+	if (settings.chain_count > 0)
+	{
+		float chain_width = settings.world_width / settings.chain_count;
+		for (size_t i = 0; i < settings.chain_count; i++)
+		{
+			add_chain(physics_engine, i * chain_width, (i + 1) * chain_width, random, bodies);
+		}
+	}
+
+	// platforms
+	for (size_t i = 0; i < settings.static_box_count; i++)
+	{
+		Vector2f position(world_x(random), 12.0f + unit(random) * settings.world_height);
+		Shape* shape = new Box_Shape(1.0f + unit(random) * 4.0f, 0.5f);
+		Body* body = new Body(Body::Type::STATIC, position, shape, nullptr, nullptr);
+		body->bouncing_ = 0.0f;
+		body->friction_ = 1.0f;
+		physics_engine.add_body(body);
+		bodies.push_back(body);
+	}
+
+	// dynamic circles
+	for (size_t i = 0; i < settings.dynamic_circle_count; i++)
+	{
+		Vector2f position(world_x(random), 14.0f + settings.world_height * (1.0f + unit(random) * 2.0f));
+		Shape* shape = new Circle_Shape(0.25f + unit(random) * 0.5f);
+		Body* body = new Body(Body::Type::DYNAMIC, position, shape, nullptr, nullptr);
+		body->bouncing_ = unit(random) * 0.5f;
+		body->friction_ = unit(random);
+		body->set_velocity(Vector2f((unit(random) - 0.5f) * 8.0f, 0.0f));
+		physics_engine.add_body(body);
+		bodies.push_back(body);
+	}
+
+	// dynamic capsules
+	for (size_t i = 0; i < settings.dynamic_capsule_count; i++)
+	{
+		Vector2f position(world_x(random), 14.0f + settings.world_height * (1.0f + unit(random) * 2.0f));
+		Shape* shape = new Capsule_Shape(0.5f, unit(random) * 0.5f);
+		Body* body = new Body(Body::Type::DYNAMIC, position, shape, nullptr, nullptr);
+		body->bouncing_ = 0.0f;
+		body->friction_ = 1.0f;
+		body->set_velocity(Vector2f((unit(random) - 0.5f) * 4.0f, 0.0f));
+		physics_engine.add_body(body);
+		bodies.push_back(body);
+	}
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include "physics_engine.h"
+
+struct Scene_Settings
+{
+	size_t dynamic_circle_count;
+	size_t dynamic_capsule_count;
+	size_t static_box_count;
+	size_t chain_count;
+
+	float world_width;
+	// platforms are spread over this height, dynamic bodies fall from above
+	float world_height;
+
+	unsigned int seed;
+
+	Scene_Settings();
+};
+
+// fills the physics engine with a procedurally generated level. The created
+// bodies are appended to bodies, the caller is responsible for deleting them.
+void generate_scene(Physics_Engine& physics_engine, const Scene_Settings& settings, std::vector<Body*>& bodies);